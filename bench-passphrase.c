@@ -0,0 +1,394 @@
+// bench-passphrase.c
+// Throughput and latency benchmark for the mock-accel passphrase paths
+//
+// Runs N threads spread round-robin over one or more /dev/mockN devices.
+// Each thread loops over one path until the duration or op count is
+// reached:
+//   single  MOCK_ACCEL_IOC_PASSPHRASE, one passphrase per op
+//   batch   MOCK_ACCEL_IOC_PASSPHRASE_BATCH, -b passphrases per op
+//   stream  read() of -s bytes in MOCK_ACCEL_IOC_STREAM mode
+//   sysfs   pread() of /sys/class/mock-accel/mockN/passphrase
+//
+// Results are printed as one JSON object on stdout; latency percentiles
+// come from the histogram in bench.h, shared with mock-accel-bench.
+//
+// Build: gcc -O2 -pthread -o bench-passphrase bench-passphrase.c
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define MOCK_ACCEL_IOC_MAGIC 'M'
+
+struct mock_accel_passphrase {
+    uint8_t word_count;
+    char passphrase[256];
+};
+
+struct mock_accel_passphrase_batch {
+    uint32_t count;
+    uint8_t word_count;
+    uint8_t separator;
+    uint16_t reserved;
+    uint64_t buf;
+    uint64_t buf_len;
+    uint32_t generated;
+    uint32_t bytes;
+};
+
+struct mock_accel_stream {
+    uint8_t enable;
+    uint8_t word_count;
+    uint8_t separator;
+    uint8_t reserved;
+};
+
+#define MOCK_ACCEL_IOC_PASSPHRASE _IOWR(MOCK_ACCEL_IOC_MAGIC, 2, struct mock_accel_passphrase)
+#define MOCK_ACCEL_IOC_PASSPHRASE_BATCH _IOWR(MOCK_ACCEL_IOC_MAGIC, 3, struct mock_accel_passphrase_batch)
+#define MOCK_ACCEL_IOC_STREAM _IOW(MOCK_ACCEL_IOC_MAGIC, 4, struct mock_accel_stream)
+
+#define MAX_DEVICES 64
+#define MAX_THREADS 256
+
+enum mode { MODE_SINGLE, MODE_BATCH, MODE_STREAM, MODE_SYSFS };
+
+static const char *const mode_names[] = {
+    [MODE_SINGLE] = "single",
+    [MODE_BATCH]  = "batch",
+    [MODE_STREAM] = "stream",
+    [MODE_SYSFS]  = "sysfs",
+};
+
+static struct {
+    enum mode mode;
+    int words;
+    uint32_t batch;
+    size_t read_size;
+    double duration;
+    uint64_t ops;           // Per thread; 0: run for duration
+    const char *devices[MAX_DEVICES];
+    int nr_devices;
+    int nr_threads;
+} cfg = {
+    .mode = MODE_SINGLE,
+    .words = 6,
+    .batch = 64,
+    .read_size = 4096,
+    .duration = 5.0,
+    .nr_threads = 1,
+};
+
+struct thread {
+    pthread_t thread;
+    int device;
+    uint64_t ops;
+    uint64_t passphrases;
+    uint64_t bytes;
+    uint64_t errors;
+    int first_errno;
+    struct bench_hist lat;
+};
+
+static pthread_barrier_t start_barrier;
+static volatile bool stop;
+
+static void record_error(struct thread *t) {
+    if (!t->errors++) {
+        t->first_errno = errno;
+    }
+}
+
+static uint64_t count_char(const char *buf, size_t len, char c) {
+    uint64_t n = 0;
+
+    for (const char *p = buf; (p = memchr(p, c, buf + len - p)); p++) {
+        n++;
+    }
+    return n;
+}
+
+// The passphrase attribute of a /dev/mockN node
+static int open_sysfs_passphrase(const char *dev) {
+    const char *name = strrchr(dev, '/');
+    char path[256];
+
+    snprintf(path, sizeof(path), "/sys/class/mock-accel/%s/passphrase", name ? name + 1 : dev);
+    return open(path, O_RDONLY);
+}
+
+// Returns the fd or -errno
+static int open_device(struct thread *t) {
+    const char *dev = cfg.devices[t->device];
+    int fd, err;
+
+    if (cfg.mode == MODE_SYSFS) {
+        fd = open_sysfs_passphrase(dev);
+    } else {
+        fd = open(dev, O_RDONLY);
+    }
+    if (fd < 0) {
+        err = errno;
+        fprintf(stderr, "%s: %s\n", dev, strerror(err));
+        return -err;
+    }
+
+    if (cfg.mode == MODE_STREAM) {
+        struct mock_accel_stream stream = { .enable = 1, .word_count = cfg.words };
+
+        if (ioctl(fd, MOCK_ACCEL_IOC_STREAM, &stream) < 0) {
+            err = errno;
+            fprintf(stderr, "%s: ioctl(STREAM): %s\n", dev, strerror(err));
+            close(fd);
+            return -err;
+        }
+    }
+    return fd;
+}
+
+static void *bench_thread(void *arg) {
+    struct thread *t = arg;
+    size_t buf_len = cfg.mode == MODE_BATCH ? (size_t)cfg.batch * 256 :
+                     cfg.mode == MODE_STREAM ? cfg.read_size : 4096;
+    char *buf = malloc(buf_len);
+    int fd = open_device(t);
+
+    bench_hist_init(&t->lat);
+
+    // Everyone waits at the barrier so main can time the run
+    pthread_barrier_wait(&start_barrier);
+    if (fd < 0 || !buf) {
+        t->errors++;
+        t->first_errno = fd < 0 ? -fd : ENOMEM;
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(buf);
+        return NULL;
+    }
+
+    while (!stop && (!cfg.ops || t->ops < cfg.ops)) {
+        struct mock_accel_passphrase pass;
+        struct mock_accel_passphrase_batch batch;
+        uint64_t start = bench_now_ns();
+        ssize_t ret;
+
+        switch (cfg.mode) {
+        case MODE_SINGLE:
+            memset(&pass, 0, sizeof(pass));
+            pass.word_count = cfg.words;
+            ret = ioctl(fd, MOCK_ACCEL_IOC_PASSPHRASE, &pass);
+            if (ret == 0) {
+                t->passphrases++;
+                t->bytes += strlen(pass.passphrase);
+            }
+            break;
+        case MODE_BATCH:
+            memset(&batch, 0, sizeof(batch));
+            batch.count = cfg.batch;
+            batch.word_count = cfg.words;
+            batch.buf = (uintptr_t)buf;
+            batch.buf_len = buf_len;
+            ret = ioctl(fd, MOCK_ACCEL_IOC_PASSPHRASE_BATCH, &batch);
+            if (ret == 0) {
+                t->passphrases += batch.generated;
+                t->bytes += batch.bytes;
+            }
+            break;
+        case MODE_STREAM:
+            ret = read(fd, buf, buf_len);
+            if (ret > 0) {
+                t->passphrases += count_char(buf, ret, '\n');
+                t->bytes += ret;
+            }
+            break;
+        case MODE_SYSFS:
+        default:
+            ret = pread(fd, buf, buf_len, 0);
+            if (ret > 0) {
+                t->passphrases++;
+                t->bytes += ret;
+            }
+            break;
+        }
+
+        if (ret < 0) {
+            record_error(t);
+            if (errno != EINTR && errno != EAGAIN) {
+                break;
+            }
+            continue;
+        }
+        bench_record(&t->lat, bench_now_ns() - start);
+        t->ops++;
+    }
+
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+static void report(struct thread *threads, double elapsed) {
+    static struct bench_hist lat;
+    uint64_t ops = 0, passphrases = 0, bytes = 0, errors = 0;
+    uint64_t dev_ops[MAX_DEVICES] = { 0 };
+    int first_errno = 0;
+
+    bench_hist_init(&lat);
+    for (int i = 0; i < cfg.nr_threads; i++) {
+        struct thread *t = &threads[i];
+
+        ops += t->ops;
+        passphrases += t->passphrases;
+        bytes += t->bytes;
+        errors += t->errors;
+        dev_ops[t->device] += t->ops;
+        if (!first_errno) {
+            first_errno = t->first_errno;
+        }
+        bench_hist_merge(&lat, &t->lat);
+    }
+
+    printf("{\"mode\":\"%s\",\"threads\":%d,\"words\":%d,", mode_names[cfg.mode],
+           cfg.nr_threads, cfg.words);
+    if (cfg.mode == MODE_BATCH) {
+        printf("\"batch\":%u,", cfg.batch);
+    } else if (cfg.mode == MODE_STREAM) {
+        printf("\"read_size\":%zu,", cfg.read_size);
+    }
+    printf("\"devices\":[");
+    for (int i = 0; i < cfg.nr_devices; i++) {
+        printf("%s{\"path\":", i ? "," : "");
+        bench_json_string(cfg.devices[i]);
+        printf(",\"ops\":%" PRIu64 "}", dev_ops[i]);
+    }
+    printf("],\"elapsed_s\":%.6f,\"ops\":%" PRIu64 ",\"ops_per_sec\":%.1f,"
+           "\"passphrases\":%" PRIu64 ",\"passphrases_per_sec\":%.1f,\"bytes\":%" PRIu64 ","
+           "\"errors\":%" PRIu64, elapsed, ops, ops / elapsed, passphrases,
+           passphrases / elapsed, bytes, errors);
+    if (errors) {
+        printf(",\"error\":");
+        bench_json_string(strerror(first_errno));
+    }
+    bench_json_latency(&lat);
+    printf("}\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [options] <device> [device...]\n", prog);
+    fprintf(stderr, "  -m MODE     single, batch, stream or sysfs (default: single)\n");
+    fprintf(stderr, "  -t THREADS  Threads, spread round-robin over the devices (default: 1)\n");
+    fprintf(stderr, "  -d SECONDS  Run time (default: 5)\n");
+    fprintf(stderr, "  -n OPS      Stop each thread after OPS operations instead\n");
+    fprintf(stderr, "  -w WORDS    Words per passphrase, 1-12 (default: 6)\n");
+    fprintf(stderr, "  -b COUNT    Passphrases per batch ioctl (default: 64)\n");
+    fprintf(stderr, "  -s BYTES    read() size in stream mode (default: 4096)\n");
+    fprintf(stderr, "\nPrints one JSON object with throughput and p50/p99/p999 latency.\n");
+    fprintf(stderr, "Example: %s -m batch -t 8 -d 10 /dev/mock0 /dev/mock1\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    struct thread *threads;
+    uint64_t start;
+    double elapsed;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:t:d:n:w:b:s:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            for (cfg.mode = 0; cfg.mode <= MODE_SYSFS; cfg.mode++) {
+                if (strcmp(optarg, mode_names[cfg.mode]) == 0) {
+                    break;
+                }
+            }
+            if (cfg.mode > MODE_SYSFS) {
+                fprintf(stderr, "Unknown mode '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            break;
+        case 't':
+            cfg.nr_threads = atoi(optarg);
+            break;
+        case 'd':
+            cfg.duration = atof(optarg);
+            break;
+        case 'n':
+            cfg.ops = strtoull(optarg, NULL, 0);
+            break;
+        case 'w':
+            cfg.words = atoi(optarg);
+            break;
+        case 'b':
+            cfg.batch = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            cfg.read_size = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (optind >= argc || argc - optind > MAX_DEVICES) {
+        usage(argv[0]);
+    }
+    if (cfg.nr_threads < 1 || cfg.nr_threads > MAX_THREADS || cfg.words < 1 ||
+        cfg.words > 12 || cfg.batch < 1 || cfg.read_size < 1 ||
+        (!cfg.ops && cfg.duration <= 0)) {
+        fprintf(stderr, "Invalid option value\n");
+        usage(argv[0]);
+    }
+    for (int i = optind; i < argc; i++) {
+        cfg.devices[cfg.nr_devices++] = argv[i];
+    }
+
+    threads = calloc(cfg.nr_threads, sizeof(*threads));
+    if (!threads) {
+        perror("calloc");
+        return 1;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, cfg.nr_threads + 1);
+    for (int i = 0; i < cfg.nr_threads; i++) {
+        threads[i].device = i % cfg.nr_devices;
+        if (pthread_create(&threads[i].thread, NULL, bench_thread, &threads[i]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    start = bench_now_ns();
+
+    if (!cfg.ops) {
+        bench_sleep(cfg.duration);
+        stop = true;
+    }
+
+    for (int i = 0; i < cfg.nr_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+    }
+    elapsed = (bench_now_ns() - start) / 1e9;
+
+    report(threads, elapsed);
+
+    for (int i = 0; i < cfg.nr_threads; i++) {
+        if (threads[i].errors) {
+            free(threads);
+            return 1;
+        }
+    }
+    free(threads);
+    return 0;
+}
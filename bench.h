@@ -0,0 +1,156 @@
+/*
+ * Latency histogram and JSON helpers shared by bench-passphrase and
+ * vfio-user/mock-accel-bench
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Each worker thread records into its own struct bench_hist; the report
+ * merges them and prints percentiles. The histogram is log-linear, 16
+ * sub-buckets per power of two (6% resolution), so runs of any length use
+ * constant memory.
+ */
+
+#ifndef MOCK_ACCEL_BENCH_H
+#define MOCK_ACCEL_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct bench_hist {
+    uint64_t count;
+    uint64_t min_ns, max_ns, sum_ns;
+    uint64_t buckets[HIST_BUCKETS];
+};
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline int bench_hist_index(uint64_t v)
+{
+    int e;
+
+    if (v < HIST_SUB) {
+        return (int)v;
+    }
+    e = 63 - __builtin_clzll(v);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* Midpoint of a bucket */
+static inline uint64_t bench_hist_value(int idx)
+{
+    int e = idx / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t sub = idx % HIST_SUB;
+
+    if (idx < HIST_SUB) {
+        return idx;
+    }
+    return ((HIST_SUB + sub) << (e - HIST_SUB_BITS)) + ((1ULL << (e - HIST_SUB_BITS)) >> 1);
+}
+
+static inline void bench_hist_init(struct bench_hist *h)
+{
+    *h = (struct bench_hist){ .min_ns = UINT64_MAX };
+}
+
+static inline void bench_record(struct bench_hist *h, uint64_t ns)
+{
+    h->buckets[bench_hist_index(ns)]++;
+    h->count++;
+    h->sum_ns += ns;
+    if (ns < h->min_ns) {
+        h->min_ns = ns;
+    }
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+}
+
+static inline void bench_hist_merge(struct bench_hist *dst, const struct bench_hist *src)
+{
+    dst->count += src->count;
+    dst->sum_ns += src->sum_ns;
+    if (src->min_ns < dst->min_ns) {
+        dst->min_ns = src->min_ns;
+    }
+    if (src->max_ns > dst->max_ns) {
+        dst->max_ns = src->max_ns;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+static inline uint64_t bench_percentile(const struct bench_hist *h, double p)
+{
+    uint64_t rank = (uint64_t)(p * h->count);
+    uint64_t seen = 0;
+
+    if (rank >= h->count) {
+        rank = h->count - 1;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            uint64_t v = bench_hist_value(i);
+
+            /* The top bucket's midpoint may lie above the largest sample */
+            return v < h->max_ns ? v : h->max_ns;
+        }
+    }
+    return 0;
+}
+
+static inline void bench_json_string(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            putchar('\\');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+/* ,"latency_ns":{...} for a non-empty histogram */
+static inline void bench_json_latency(const struct bench_hist *h)
+{
+    if (!h->count) {
+        return;
+    }
+    printf(",\"latency_ns\":{\"min\":%" PRIu64 ",\"mean\":%" PRIu64 ",\"p50\":%" PRIu64
+           ",\"p99\":%" PRIu64 ",\"p999\":%" PRIu64 ",\"max\":%" PRIu64 "}",
+           h->min_ns, h->sum_ns / h->count, bench_percentile(h, 0.50),
+           bench_percentile(h, 0.99), bench_percentile(h, 0.999), h->max_ns);
+}
+
+/* Sleep for seconds on CLOCK_MONOTONIC, restarting after signals */
+static inline void bench_sleep(double seconds)
+{
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (time_t)seconds;
+    deadline.tv_nsec += (long)((seconds - (time_t)seconds) * 1e9);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+}
+
+#endif /* MOCK_ACCEL_BENCH_H */
@@ -1,9 +1,12 @@
 package discovery
 
 import (
+	"errors"
 	"fmt"
+	"io/fs"
 	"os"
 	"path/filepath"
+	"strconv"
 	"strings"
 
 	"k8s.io/klog/v2"
@@ -100,8 +103,81 @@ func (s *DeviceScanner) Scan() (map[string]*DiscoveredDevice, error) {
 	return s.lastScan, nil
 }
 
-// scanDevice reads properties of a single device
+// scanDevice reads properties of a single device, from the single
+// device_info attribute when the driver provides it
 func (s *DeviceScanner) scanDevice(devName, devPath string) (*DiscoveredDevice, error) {
+	info, err := readDeviceInfo(devPath)
+	if err == nil {
+		return s.scanDeviceInfo(devName, devPath, info)
+	}
+	if !errors.Is(err, fs.ErrNotExist) {
+		return nil, fmt.Errorf("failed to read device_info: %w", err)
+	}
+	return s.scanDeviceAttrs(devName, devPath)
+}
+
+// scanDeviceInfo fills a device from parsed device_info contents. Keys
+// older drivers may not report fall back to the individual sources.
+func (s *DeviceScanner) scanDeviceInfo(devName, devPath string, info map[string]string) (*DiscoveredDevice, error) {
+	dev := &DiscoveredDevice{
+		Name: devName,
+	}
+
+	var ok bool
+	var err error
+
+	dev.UUID, ok = info["uuid"]
+	if !ok {
+		return nil, fmt.Errorf("device_info has no uuid")
+	}
+
+	memorySize, ok := info["memory_size"]
+	if !ok {
+		return nil, fmt.Errorf("device_info has no memory_size")
+	}
+	dev.MemorySize, err = strconv.ParseInt(memorySize, 10, 64)
+	if err != nil {
+		return nil, fmt.Errorf("failed to parse memory_size: %w", err)
+	}
+
+	if caps, ok := info["capabilities"]; ok {
+		val, err := parseUint32(caps)
+		if err != nil {
+			return nil, fmt.Errorf("failed to parse capabilities: %w", err)
+		}
+		dev.Capabilities = uint32(val)
+	}
+
+	if numa, ok := info["numa_node"]; ok {
+		dev.NumaNode, err = strconv.Atoi(numa)
+		if err != nil {
+			return nil, fmt.Errorf("failed to parse numa_node: %w", err)
+		}
+	} else if dev.NumaNode, err = readNumaNode(devPath); err != nil {
+		return nil, fmt.Errorf("failed to read numa_node: %w", err)
+	}
+
+	if dev.PCIAddress, ok = info["pci_address"]; !ok {
+		dev.PCIAddress, err = readPCIAddress(devPath)
+		if err != nil {
+			return nil, fmt.Errorf("failed to read PCI address: %w", err)
+		}
+	}
+
+	// The driver knows whether it is a VF; the name is only a fallback
+	if dev.DeviceType, ok = info["type"]; !ok {
+		dev.DeviceType = detectDeviceType(devName)
+	}
+	if dev.DeviceType == "vf" {
+		dev.PhysFn = parsePhysFnName(devName)
+	}
+
+	return dev, nil
+}
+
+// scanDeviceAttrs reads properties one sysfs attribute at a time, for
+// drivers without device_info
+func (s *DeviceScanner) scanDeviceAttrs(devName, devPath string) (*DiscoveredDevice, error) {
 	dev := &DiscoveredDevice{
 		Name: devName,
 	}
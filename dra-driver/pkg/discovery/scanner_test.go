@@ -162,6 +162,123 @@ func TestDeviceScanner_ScanNonexistentPath(t *testing.T) {
 	}
 }
 
+func TestDeviceScanner_ScanDeviceInfo(t *testing.T) {
+	sysfsPath := setupMockSysfs(t)
+
+	// mock1 gains device_info; its individual attributes must not be used
+	devDir := filepath.Join(sysfsPath, "mock1")
+	writeAttr(t, devDir, "device_info", "uuid=NODE1-NUMA1-PF-INFO\n"+
+		"memory_size=8589934592\n"+
+		"memory_bar_size=0\n"+
+		"capabilities=0x0000001f\n"+
+		"status=0x00000000\n"+
+		"numa_node=3\n"+
+		"pci_address=0000:31:00.0\n"+
+		"type=pf\n"+
+		"sriov_totalvfs=4\n"+
+		"future_key=ignored\n")
+
+	scanner := NewDeviceScanner("test-node")
+	scanner.SetSysfsPath(sysfsPath)
+
+	devices, err := scanner.Scan()
+	if err != nil {
+		t.Fatalf("Scan failed: %v", err)
+	}
+
+	if len(devices) != 3 {
+		t.Errorf("Expected 3 devices, got %d", len(devices))
+	}
+
+	mock1, ok := devices["mock1"]
+	if !ok {
+		t.Fatal("Device mock1 not found")
+	}
+
+	if mock1.UUID != "NODE1-NUMA1-PF-INFO" {
+		t.Errorf("Expected UUID 'NODE1-NUMA1-PF-INFO', got '%s'", mock1.UUID)
+	}
+
+	if mock1.MemorySize != 8589934592 {
+		t.Errorf("Expected memory size 8589934592, got %d", mock1.MemorySize)
+	}
+
+	if mock1.Capabilities != 0x1f {
+		t.Errorf("Expected capabilities 0x1f, got 0x%x", mock1.Capabilities)
+	}
+
+	if mock1.NumaNode != 3 {
+		t.Errorf("Expected NUMA node 3, got %d", mock1.NumaNode)
+	}
+
+	if mock1.PCIAddress != "0000:31:00.0" {
+		t.Errorf("Expected PCI address '0000:31:00.0', got '%s'", mock1.PCIAddress)
+	}
+
+	if mock1.DeviceType != "pf" {
+		t.Errorf("Expected device type 'pf', got '%s'", mock1.DeviceType)
+	}
+
+	// Devices without device_info still scan through the individual attributes
+	if devices["mock0"].UUID != "NODE1-NUMA0-PF" {
+		t.Errorf("Expected UUID 'NODE1-NUMA0-PF', got '%s'", devices["mock0"].UUID)
+	}
+}
+
+func TestDeviceScanner_ScanDeviceInfoFallback(t *testing.T) {
+	sysfsPath := setupMockSysfs(t)
+
+	// An older driver: no numa_node, pci_address or type keys
+	devDir := filepath.Join(sysfsPath, "mock0_vf0")
+	writeAttr(t, devDir, "device_info", "uuid=NODE1-NUMA0-VF0\nmemory_size=2147483648\n")
+
+	scanner := NewDeviceScanner("test-node")
+	scanner.SetSysfsPath(sysfsPath)
+
+	devices, err := scanner.Scan()
+	if err != nil {
+		t.Fatalf("Scan failed: %v", err)
+	}
+
+	vf0, ok := devices["mock0_vf0"]
+	if !ok {
+		t.Fatal("Device mock0_vf0 not found")
+	}
+
+	if vf0.PCIAddress != "0000:11:00.1" {
+		t.Errorf("Expected PCI address '0000:11:00.1', got '%s'", vf0.PCIAddress)
+	}
+
+	if vf0.DeviceType != "vf" || vf0.PhysFn != "mock0" {
+		t.Errorf("Expected VF of mock0, got type '%s' PhysFn '%s'", vf0.DeviceType, vf0.PhysFn)
+	}
+
+	if vf0.Capabilities != 0 {
+		t.Errorf("Expected capabilities 0, got %d", vf0.Capabilities)
+	}
+}
+
+func TestDeviceScanner_ScanDeviceInfoMissingUUID(t *testing.T) {
+	sysfsPath := setupMockSysfs(t)
+	writeAttr(t, filepath.Join(sysfsPath, "mock0"), "device_info", "memory_size=1\n")
+
+	scanner := NewDeviceScanner("test-node")
+	scanner.SetSysfsPath(sysfsPath)
+
+	devices, err := scanner.Scan()
+	if err != nil {
+		t.Fatalf("Scan failed: %v", err)
+	}
+
+	// Broken devices are skipped, not fatal
+	if _, ok := devices["mock0"]; ok {
+		t.Error("Expected mock0 with incomplete device_info to be skipped")
+	}
+	if len(devices) != 2 {
+		t.Errorf("Expected 2 devices, got %d", len(devices))
+	}
+}
+
 func TestDetectDeviceType(t *testing.T) {
 	tests := []struct {
 		name     string
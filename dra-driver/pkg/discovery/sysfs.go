@@ -39,17 +39,40 @@ func readSysfsUint32(devPath, attr string) (uint32, error) {
 	}
 
 	// Handle both decimal and hex (0x prefix)
+	val, err := parseUint32(str)
+	if err != nil {
+		return 0, fmt.Errorf("failed to parse %s as uint32: %w", attr, err)
+	}
+	return uint32(val), nil
+}
+
+// readDeviceInfo reads the driver's aggregated device_info attribute: one
+// key=value pair per line. Unknown keys are kept so callers can ignore them.
+func readDeviceInfo(devPath string) (map[string]string, error) {
+	data, err := os.ReadFile(filepath.Join(devPath, "device_info"))
+	if err != nil {
+		return nil, err
+	}
+
+	info := make(map[string]string, 12)
+	for _, line := range strings.Split(string(data), "\n") {
+		key, value, ok := strings.Cut(strings.TrimSpace(line), "=")
+		if !ok {
+			continue
+		}
+		info[key] = value
+	}
+	return info, nil
+}
+
+// parseUint32 parses a decimal or 0x-prefixed hex uint32
+func parseUint32(str string) (uint64, error) {
 	base := 10
 	if strings.HasPrefix(str, "0x") || strings.HasPrefix(str, "0X") {
 		base = 16
 		str = str[2:]
 	}
-
-	val, err := strconv.ParseUint(str, base, 32)
-	if err != nil {
-		return 0, fmt.Errorf("failed to parse %s as uint32: %w", attr, err)
-	}
-	return uint32(val), nil
+	return strconv.ParseUint(str, base, 32)
 }
 
 // readNumaNode reads the NUMA node from the device symlink
@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Mock Accelerator tracepoints
+ *
+ * Available under /sys/kernel/tracing/events/mock_accel/ and to perf and
+ * bpftrace as mock_accel:<event>. Devices are identified by their minor
+ * number, as in /dev/mockN.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mock_accel
+
+#if !defined(_MOCK_ACCEL_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _MOCK_ACCEL_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(mock_accel_ioctl_enter,
+	TP_PROTO(int minor, unsigned int cmd),
+	TP_ARGS(minor, cmd),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(unsigned int, cmd)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->cmd = cmd;
+	),
+	TP_printk("mock%d cmd=0x%x", __entry->minor, __entry->cmd)
+);
+
+TRACE_EVENT(mock_accel_ioctl_exit,
+	TP_PROTO(int minor, unsigned int cmd, long ret),
+	TP_ARGS(minor, cmd, ret),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(unsigned int, cmd)
+		__field(long, ret)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->cmd = cmd;
+		__entry->ret = ret;
+	),
+	TP_printk("mock%d cmd=0x%x ret=%ld", __entry->minor, __entry->cmd, __entry->ret)
+);
+
+/* One generated passphrase, on every path that builds them */
+TRACE_EVENT(mock_accel_passphrase,
+	TP_PROTO(int minor, unsigned int words, unsigned int len),
+	TP_ARGS(minor, words, len),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(unsigned int, words)
+		__field(unsigned int, len)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->words = words;
+		__entry->len = len;
+	),
+	TP_printk("mock%d words=%u len=%u", __entry->minor, __entry->words, __entry->len)
+);
+
+DECLARE_EVENT_CLASS(mock_accel_mmio,
+	TP_PROTO(int minor, u32 offset, u32 len, u32 value),
+	TP_ARGS(minor, offset, len, value),
+	TP_STRUCT__entry(
+		__field(int, minor)
+		__field(u32, offset)
+		__field(u32, len)
+		__field(u32, value)
+	),
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->offset = offset;
+		__entry->len = len;
+		__entry->value = value;
+	),
+	TP_printk("mock%d offset=0x%x len=%u value=0x%08x",
+		  __entry->minor, __entry->offset, __entry->len, __entry->value)
+);
+
+/* Register offsets; len > 4 for block reads, which log value 0 */
+DEFINE_EVENT(mock_accel_mmio, mock_accel_mmio_read,
+	TP_PROTO(int minor, u32 offset, u32 len, u32 value),
+	TP_ARGS(minor, offset, len, value)
+);
+
+DEFINE_EVENT(mock_accel_mmio, mock_accel_mmio_write,
+	TP_PROTO(int minor, u32 offset, u32 len, u32 value),
+	TP_ARGS(minor, offset, len, value)
+);
+
+#endif /* _MOCK_ACCEL_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mock-accel-trace
+#include <trace/define_trace.h>
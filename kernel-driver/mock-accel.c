@@ -4,6 +4,10 @@
  *
  * A simple PCI driver for mock accelerator devices emulated via vfio-user.
  * Exposes device attributes via sysfs for DRA driver discovery.
+ *
+ * Hot paths are instrumented with tracepoints (mock-accel-trace.h) and
+ * per-CPU counters and latency histograms under
+ * /sys/kernel/debug/mock-accel/.
  */
 
 #include <linux/module.h>
@@ -19,6 +23,33 @@
 #include <linux/ioctl.h>
 #include <linux/random.h>
 #include <linux/string.h>
+#include <linux/interrupt.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/sched/signal.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#include <linux/io_uring/cmd.h>
+#define MOCK_ACCEL_HAVE_URING_CMD
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#include <linux/io_uring.h>
+#define MOCK_ACCEL_HAVE_URING_CMD
+#endif
+
+#define CREATE_TRACE_POINTS
+#include "mock-accel-trace.h"
 
 #define DRV_NAME "mock-accel"
 #define DRV_VERSION "0.1.0"
@@ -42,14 +73,39 @@
 #define REG_PASSPHRASE_LENGTH  0x104
 #define REG_PASSPHRASE_STATUS  0x108
 #define REG_PASSPHRASE_COUNT   0x10C
+#define REG_PASSPHRASE_BYTES   0x110  /* Result length, 0 on older servers */
 #define REG_PASSPHRASE_BUFFER  0x200
+#define PASSPHRASE_BUFFER_SIZE 256
+
+/*
+ * BAR0 page 1: copy of offsets 0x000-0x2FF (identity, passphrase registers
+ * and buffer) that the device lets the guest map directly, so reads
+ * through it do not trap. The mapping is writable, but a store to it is
+ * not a register write: the device never reads the page back and rewrites
+ * it on the next update. Register writes go to page 0.
+ */
+#define INFO_PAGE_OFFSET    0x1000
+#define INFO_PAGE_SIZE      0x1000
+
+/* Capability flags */
+#define CAP_INFO_PAGE       (1 << 2)
+#define CAP_MEMORY_BAR      (1 << 3)  /* Device memory in BAR2 */
 
 /* BAR sizes */
-#define BAR0_SIZE           4096
+#define BAR0_SIZE           4096  /* Minimum; 16K with the info page and result window */
+#define MEMORY_BAR          2
+
+/* MSI-X vectors */
+#define MOCK_ACCEL_IRQ_PASSPHRASE 0  /* Passphrase command completed */
+#define MOCK_ACCEL_IRQ_RING       1  /* Descriptor ring drained */
+#define MOCK_ACCEL_NR_IRQS        2
+#define MOCK_ACCEL_PASSPHRASE_TIMEOUT_MS 1000
 
 /* Character device definitions */
 #define MOCK_ACCEL_MAX_DEVICES 256
 #define MOCK_ACCEL_WORDLIST_SIZE 7776
+#define MOCK_ACCEL_WORDLIST_FW "mock-accel-wordlist.txt"
+#define MOCK_ACCEL_MAX_WORD_LEN 255
 #define MOCK_ACCEL_MAX_WORDS 12
 #define MOCK_ACCEL_DEFAULT_WORDS 6
 
@@ -63,28 +119,181 @@ struct mock_accel_passphrase {
 };
 #define MOCK_ACCEL_IOC_PASSPHRASE _IOWR(MOCK_ACCEL_IOC_MAGIC, 2, struct mock_accel_passphrase)
 
+/*
+ * Bulk generation: count passphrases are written to buf back to back, each
+ * NUL-terminated. Generation stops early when buf_len is exhausted; the
+ * number actually written is returned in generated/bytes.
+ */
+struct mock_accel_passphrase_batch {
+	__u32 count;             /* Input: passphrases to generate */
+	__u8 word_count;         /* Input: 1-12 words (0 = default 6) */
+	__u8 separator;          /* Input: word separator (0 = '-') */
+	__u16 reserved;          /* Must be zero */
+	__u64 buf;               /* Input: user buffer address */
+	__u64 buf_len;           /* Input: user buffer size */
+	__u32 generated;         /* Output: passphrases written */
+	__u32 bytes;             /* Output: bytes written, including NULs */
+};
+#define MOCK_ACCEL_IOC_PASSPHRASE_BATCH _IOWR(MOCK_ACCEL_IOC_MAGIC, 3, struct mock_accel_passphrase_batch)
+
+/* Bounce buffer for batch generation; filled under RCU, copied out after */
+#define MOCK_ACCEL_BATCH_CHUNK PAGE_SIZE
+
+/*
+ * Switch this open file between the info banner (enable = 0) and a
+ * continuous stream of newline-separated passphrases on read()
+ */
+struct mock_accel_stream {
+	__u8 enable;
+	__u8 word_count;         /* 1-12 words (0 = default 6) */
+	__u8 separator;          /* Word separator (0 = '-') */
+	__u8 reserved;           /* Must be zero */
+};
+#define MOCK_ACCEL_IOC_STREAM _IOW(MOCK_ACCEL_IOC_MAGIC, 4, struct mock_accel_stream)
+
+/* Stream output is generated a page at a time; must hold one passphrase */
+#define MOCK_ACCEL_STREAM_CHUNK PAGE_SIZE
+
+/*
+ * Shared result ring, mapped with mmap(fd, offset 0) after RING_SETUP.
+ *
+ * The first page holds the control block, followed by nr_slots slots of
+ * slot_size bytes, each a NUL-terminated passphrase. head and tail are
+ * free-running; slot i lives at data_offset + (i & (nr_slots - 1)) *
+ * slot_size. The kernel fills slots [head, tail + nr_slots) and publishes
+ * head with release semantics; user space consumes [tail, head) and
+ * stores tail back. MOCK_ACCEL_IOC_RING_FILL refills every free slot, so
+ * consumers only enter the kernel when the ring runs dry.
+ */
+struct mock_accel_ring {
+	__u32 head;              /* Written by the kernel */
+	__u32 pad0[15];
+	__u32 tail;              /* Written by user space */
+	__u32 pad1[15];
+	__u32 nr_slots;
+	__u32 slot_size;
+	__u32 data_offset;
+};
+
+struct mock_accel_ring_setup {
+	__u32 nr_slots;          /* Input: power of two, 1-65536 */
+	__u8 word_count;         /* Input: 1-12 words (0 = default 6) */
+	__u8 separator;          /* Input: word separator (0 = '-') */
+	__u16 reserved;          /* Must be zero */
+	__u64 mmap_size;         /* Output: bytes to mmap() */
+};
+#define MOCK_ACCEL_IOC_RING_SETUP _IOWR(MOCK_ACCEL_IOC_MAGIC, 5, struct mock_accel_ring_setup)
+#define MOCK_ACCEL_IOC_RING_FILL _IO(MOCK_ACCEL_IOC_MAGIC, 6)  /* Returns slots filled */
+
+/*
+ * Device memory (BAR2) is mapped with mmap(fd, MOCK_ACCEL_MMAP_MEMORY +
+ * offset); memory_bar_size in sysfs gives its length.
+ */
+#define MOCK_ACCEL_MMAP_MEMORY (1ULL << 32)
+
+/*
+ * io_uring passthrough (IORING_OP_URING_CMD): cmd_op is one of the
+ * PASSPHRASE ioctl numbers and the SQE command area starts with the user
+ * pointer that would be the ioctl argument. The CQE result is the ioctl
+ * return value.
+ */
+struct mock_accel_uring_cmd {
+	__u64 arg;
+};
+
+/* Larger batches are punted to io-wq rather than run at submission */
+#define MOCK_ACCEL_URING_INLINE_BATCH 64
+
+#define MOCK_ACCEL_RING_MAX_SLOTS 65536
+#define MOCK_ACCEL_RING_SLOT_SIZE 256
+/* Slots filled per RCU read section before rescheduling */
+#define MOCK_ACCEL_RING_FILL_BATCH 256
+
+/*
+ * Parsed wordlist: a packed index into the firmware image, which is kept
+ * for the lifetime of the wordlist. Words are not NUL-terminated.
+ *
+ * One wordlist is shared by every device bound to the driver. The module
+ * holds a reference to the current one and each device holds another, so
+ * a replaced wordlist is freed once no device uses it.
+ *
+ * A published wordlist is immutable. Generators only take rcu_read_lock()
+ * around their use of mdev->wordlist; the final put waits for a grace
+ * period before freeing, so a reload never blocks or races them.
+ */
+struct mock_accel_word {
+	u32 offset;		/* Byte offset into fw->data */
+	u8 len;
+} __packed;
+
+struct mock_accel_wordlist {
+	struct kref ref;
+	const struct firmware *fw;
+	size_t count;
+	struct mock_accel_word words[];
+};
+
+/*
+ * debugfs statistics. Latency buckets are log2(ns): bucket k counts
+ * [2^k, 2^(k+1)) ns and the last one everything above.
+ */
+#define MOCK_ACCEL_HIST_BUCKETS 32
+
+struct mock_accel_hist {
+	u64 count;
+	u64 sum_ns;
+	u64 buckets[MOCK_ACCEL_HIST_BUCKETS];
+};
+
+/* Per-CPU, so concurrent callers never contend; summed when read */
+struct mock_accel_stats {
+	u64 mmio_reads;
+	u64 mmio_writes;
+	u64 passphrases;
+	u64 ioctl_errors;
+	struct mock_accel_hist ioctl;
+	struct mock_accel_hist passphrase_read;	/* sysfs passphrase */
+};
+
 /* Device state */
 struct mock_accel_dev {
 	struct pci_dev *pdev;
 	void __iomem *bar0;
+	void __iomem *info;	/* Register reads: info page, or bar0 */
+	resource_size_t mem_bar_size;	/* Device memory BAR, 0 if absent */
 	struct device *class_dev;
 	int minor;
 
+	/* Instrumentation */
+	struct mock_accel_stats __percpu *stats;
+	struct dentry *debugfs;
+
 	/* Character device */
 	struct cdev cdev;
 
-	/* Cached device attributes */
+	/*
+	 * Cached device attributes. Only the driver writes REG_STATUS, so
+	 * status is read once at probe and then tracks status_store();
+	 * status_lock keeps the register and the cache in step.
+	 */
 	uuid_t uuid;
 	u64 memory_size;
 	u32 capabilities;
 	u32 status;
 	u32 fw_version;
+	struct mutex status_lock;
+
+	/* Completion interrupts (nr_irqs == 0: poll the status register) */
+	int nr_irqs;
+	struct completion passphrase_done;
+	struct mutex passphrase_lock;	/* Serializes passphrase commands */
+
+	/* Shared wordlist reference, NULL if firmware is not loaded */
+	struct mock_accel_wordlist __rcu *wordlist;
+	struct list_head node;	/* On mock_accel_devices */
 
-	/* Firmware management */
-	const struct firmware *wordlist_fw;
-	bool wordlist_loaded;
-	char **wordlist;         /* Parsed word array */
-	size_t wordlist_count;   /* Number of words loaded */
+	/* Words per passphrase for files opened in stream mode, 0: banner */
+	u8 stream_words;
 
 	/* SR-IOV support */
 	bool is_vf;
@@ -97,17 +306,95 @@ static struct class *mock_accel_class;
 static DEFINE_IDA(mock_accel_ida);
 static dev_t mock_accel_devt;  /* First device number */
 
+/* Current wordlist and the devices using it, protected by mock_accel_lock */
+static DEFINE_MUTEX(mock_accel_lock);
+static struct mock_accel_wordlist *mock_accel_wordlist;
+static LIST_HEAD(mock_accel_devices);
+static bool mock_accel_fw_pending;	/* Asynchronous load in flight */
+static u64 mock_accel_fw_start;
+
+/* Woken whenever a device gains a wordlist, for blocked stream readers */
+static DECLARE_WAIT_QUEUE_HEAD(mock_accel_wordlist_wait);
+
+/* debugfs root and firmware load latency, protected by mock_accel_fw_lock */
+static struct dentry *mock_accel_debugfs;
+static DEFINE_SPINLOCK(mock_accel_fw_lock);
+static struct mock_accel_hist mock_accel_fw_load;
+static u64 mock_accel_fw_errors;
+
+/* Per-open state of /dev/mockN */
+struct mock_accel_file {
+	struct mock_accel_dev *mdev;
+	struct mutex lock;	/* Serializes stream reads and mode changes */
+
+	/* Streaming mode */
+	bool stream;
+	u8 stream_words;
+	char stream_separator;
+	char *chunk;		/* MOCK_ACCEL_STREAM_CHUNK bytes, allocated on enable */
+	size_t chunk_off;	/* Next byte to hand out */
+	size_t chunk_len;	/* Valid bytes in chunk */
+
+	/*
+	 * mmap()ed result ring, set up once and freed on release. ring is
+	 * published last so mock_accel_mmap() can read ring and ring_size
+	 * without file->lock.
+	 */
+	struct mock_accel_ring *ring;
+	size_t ring_size;
+	u32 ring_slots;		/* Private copies: the mapping is user-writable */
+	u32 ring_head;
+	u8 ring_words;
+	char ring_separator;
+};
+
+static unsigned int mock_accel_hist_bucket(u64 ns)
+{
+	return ns ? min_t(unsigned int, ilog2(ns), MOCK_ACCEL_HIST_BUCKETS - 1) : 0;
+}
+
+static void mock_accel_hist_add(struct mock_accel_hist __percpu *hist, u64 ns)
+{
+	this_cpu_inc(hist->count);
+	this_cpu_add(hist->sum_ns, ns);
+	this_cpu_inc(hist->buckets[mock_accel_hist_bucket(ns)]);
+}
+
+/*
+ * Register accessors. Reads go through the info page when there is one;
+ * reg is always the register offset.
+ */
+static u32 mock_accel_read32(struct mock_accel_dev *mdev, u32 reg)
+{
+	u32 val = ioread32(mdev->info + reg);
+
+	this_cpu_inc(mdev->stats->mmio_reads);
+	trace_mock_accel_mmio_read(mdev->minor, reg, sizeof(val), val);
+	return val;
+}
+
+static void mock_accel_read_block(struct mock_accel_dev *mdev, u32 reg,
+				  void *buf, size_t len)
+{
+	memcpy_fromio(buf, mdev->info + reg, len);
+
+	this_cpu_inc(mdev->stats->mmio_reads);
+	trace_mock_accel_mmio_read(mdev->minor, reg, len, 0);
+}
+
+static void mock_accel_write32(struct mock_accel_dev *mdev, u32 reg, u32 val)
+{
+	this_cpu_inc(mdev->stats->mmio_writes);
+	trace_mock_accel_mmio_write(mdev->minor, reg, sizeof(val), val);
+	iowrite32(val, mdev->bar0 + reg);
+}
+
 /*
  * Read UUID from BAR0
  */
 static void read_uuid(struct mock_accel_dev *mdev)
 {
-	u32 *uuid_words = (u32 *)&mdev->uuid;
-	int i;
-
-	for (i = 0; i < 4; i++) {
-		uuid_words[i] = ioread32(mdev->bar0 + REG_UUID + (i * 4));
-	}
+	mock_accel_read_block(mdev, REG_UUID, &mdev->uuid, sizeof(mdev->uuid));
 }
 
 /*
@@ -117,133 +404,325 @@ static void read_device_attrs(struct mock_accel_dev *mdev)
 {
 	u32 mem_lo, mem_hi;
 
+	/* Read everything else through the info page when there is one */
+	mdev->info = mdev->bar0;
+	mdev->capabilities = mock_accel_read32(mdev, REG_CAPABILITIES);
+	if ((mdev->capabilities & CAP_INFO_PAGE) &&
+	    pci_resource_len(mdev->pdev, 0) >= INFO_PAGE_OFFSET + INFO_PAGE_SIZE)
+		mdev->info = mdev->bar0 + INFO_PAGE_OFFSET;
+
 	read_uuid(mdev);
 
-	mem_lo = ioread32(mdev->bar0 + REG_MEMORY_SIZE);
-	mem_hi = ioread32(mdev->bar0 + REG_MEMORY_SIZE + 4);
+	mem_lo = mock_accel_read32(mdev, REG_MEMORY_SIZE);
+	mem_hi = mock_accel_read32(mdev, REG_MEMORY_SIZE + 4);
 	mdev->memory_size = ((u64)mem_hi << 32) | mem_lo;
 
-	mdev->capabilities = ioread32(mdev->bar0 + REG_CAPABILITIES);
-	mdev->status = ioread32(mdev->bar0 + REG_STATUS);
-	mdev->fw_version = ioread32(mdev->bar0 + REG_FW_VERSION);
+	mdev->status = mock_accel_read32(mdev, REG_STATUS);
+	mdev->fw_version = mock_accel_read32(mdev, REG_FW_VERSION);
 }
 
 /*
- * Load and parse wordlist firmware
+ * Passphrase completion interrupt
  */
-static int mock_accel_load_wordlist(struct mock_accel_dev *mdev)
+static irqreturn_t mock_accel_passphrase_irq(int irq, void *data)
 {
-	const struct firmware *fw;
-	char *data, *line, *next;
-	size_t i = 0;
-	int ret;
+	struct mock_accel_dev *mdev = data;
+
+	complete(&mdev->passphrase_done);
+	return IRQ_HANDLED;
+}
+
+/*
+ * Allocate MSI-X vectors. Devices without MSI-X (older servers) fall back
+ * to status polling.
+ */
+static int mock_accel_setup_irqs(struct mock_accel_dev *mdev)
+{
+	struct pci_dev *pdev = mdev->pdev;
+	int nvec, ret;
 
-	ret = request_firmware(&fw, "mock-accel-wordlist.txt", &mdev->pdev->dev);
+	nvec = pci_alloc_irq_vectors(pdev, 1, MOCK_ACCEL_NR_IRQS, PCI_IRQ_MSIX);
+	if (nvec < 0) {
+		dev_info(&pdev->dev, "MSI-X not available (%d), polling for completion\n", nvec);
+		mdev->nr_irqs = 0;
+		return 0;
+	}
+
+	ret = request_irq(pci_irq_vector(pdev, MOCK_ACCEL_IRQ_PASSPHRASE),
+			  mock_accel_passphrase_irq, 0, DRV_NAME, mdev);
 	if (ret) {
-		dev_err(&mdev->pdev->dev, "Failed to load wordlist firmware: %d\n", ret);
+		dev_err(&pdev->dev, "Failed to request passphrase IRQ: %d\n", ret);
+		pci_free_irq_vectors(pdev);
+		mdev->nr_irqs = 0;
 		return ret;
 	}
 
-	mdev->wordlist_fw = fw;
+	mdev->nr_irqs = nvec;
+	dev_info(&pdev->dev, "Using %d MSI-X vector(s)\n", nvec);
+	return 0;
+}
 
-	/* Allocate word array */
-	mdev->wordlist = kmalloc_array(MOCK_ACCEL_WORDLIST_SIZE, sizeof(char *), GFP_KERNEL);
-	if (!mdev->wordlist) {
-		release_firmware(fw);
-		mdev->wordlist_fw = NULL;
-		return -ENOMEM;
-	}
+static void mock_accel_free_irqs(struct mock_accel_dev *mdev)
+{
+	if (!mdev->nr_irqs)
+		return;
+
+	free_irq(pci_irq_vector(mdev->pdev, MOCK_ACCEL_IRQ_PASSPHRASE), mdev);
+	pci_free_irq_vectors(mdev->pdev);
+	mdev->nr_irqs = 0;
+}
 
-	/* Parse firmware data (one word per line) */
-	data = kmalloc(fw->size + 1, GFP_KERNEL);
-	if (!data) {
-		kfree(mdev->wordlist);
-		mdev->wordlist = NULL;
+/*
+ * Parse wordlist firmware (one word per line), taking ownership of fw
+ *
+ * The index references fw->data directly, so a load costs one allocation
+ * on top of the firmware itself. dev is only used for messages.
+ */
+static struct mock_accel_wordlist *mock_accel_parse_wordlist(struct device *dev,
+							     const struct firmware *fw)
+{
+	struct mock_accel_wordlist *wl;
+	const char *data;
+	size_t pos = 0, i = 0;
+
+	wl = kvmalloc(struct_size(wl, words, MOCK_ACCEL_WORDLIST_SIZE), GFP_KERNEL);
+	if (!wl) {
 		release_firmware(fw);
-		mdev->wordlist_fw = NULL;
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 	}
+	kref_init(&wl->ref);
+	wl->fw = fw;
 
-	memcpy(data, fw->data, fw->size);
-	data[fw->size] = '\0';
+	data = fw->data;
+	while (pos < fw->size && i < MOCK_ACCEL_WORDLIST_SIZE) {
+		size_t start, end;
 
-	line = data;
-	while (line && *line && i < MOCK_ACCEL_WORDLIST_SIZE) {
 		/* Find end of line */
-		next = strchr(line, '\n');
-		if (next)
-			*next++ = '\0';
-
-		/* Skip empty lines and whitespace */
-		while (*line == ' ' || *line == '\t' || *line == '\r')
-			line++;
-
-		if (*line) {
-			/* Remove trailing whitespace */
-			char *end = line + strlen(line) - 1;
-			while (end > line && (*end == ' ' || *end == '\t' || *end == '\r'))
-				*end-- = '\0';
-
-			mdev->wordlist[i] = kstrdup(line, GFP_KERNEL);
-			if (!mdev->wordlist[i]) {
-				/* Cleanup on error */
-				while (i > 0)
-					kfree(mdev->wordlist[--i]);
-				kfree(mdev->wordlist);
-				mdev->wordlist = NULL;
-				kfree(data);
-				release_firmware(fw);
-				mdev->wordlist_fw = NULL;
-				return -ENOMEM;
-			}
-			i++;
+		end = pos;
+		while (end < fw->size && data[end] != '\n')
+			end++;
+		start = pos;
+		pos = end + 1;
+
+		/* Skip empty lines and surrounding whitespace */
+		while (start < end && (data[start] == ' ' || data[start] == '\t' ||
+				       data[start] == '\r'))
+			start++;
+		while (end > start && (data[end - 1] == ' ' || data[end - 1] == '\t' ||
+				       data[end - 1] == '\r'))
+			end--;
+		if (start == end)
+			continue;
+
+		if (end - start > MOCK_ACCEL_MAX_WORD_LEN) {
+			dev_err(dev, "Wordlist entry %zu too long\n", i);
+			kvfree(wl);
+			release_firmware(fw);
+			return ERR_PTR(-EINVAL);
 		}
 
-		line = next;
+		wl->words[i].offset = start;
+		wl->words[i].len = end - start;
+		i++;
 	}
 
-	mdev->wordlist_count = i;
-	kfree(data);
+	if (i == 0) {
+		kvfree(wl);
+		release_firmware(fw);
+		return ERR_PTR(-ENODATA);
+	}
 
-	dev_info(&mdev->pdev->dev, "Loaded %zu words from firmware\n", mdev->wordlist_count);
-	return 0;
+	wl->count = i;
+
+	dev_info(dev, "Loaded %zu words from firmware\n", wl->count);
+	return wl;
+}
+
+/* Account one firmware load, from request to parsed wordlist, for debugfs */
+static void mock_accel_fw_load_record(u64 ns, bool ok)
+{
+	spin_lock(&mock_accel_fw_lock);
+	mock_accel_fw_load.count++;
+	mock_accel_fw_load.sum_ns += ns;
+	mock_accel_fw_load.buckets[mock_accel_hist_bucket(ns)]++;
+	if (!ok)
+		mock_accel_fw_errors++;
+	spin_unlock(&mock_accel_fw_lock);
+}
+
+/* Load and parse the wordlist firmware synchronously */
+static struct mock_accel_wordlist *mock_accel_load_wordlist(struct device *dev)
+{
+	struct mock_accel_wordlist *wl;
+	const struct firmware *fw;
+	u64 start = ktime_get_ns();
+	int ret;
+
+	ret = request_firmware(&fw, MOCK_ACCEL_WORDLIST_FW, dev);
+	if (ret) {
+		dev_err(dev, "Failed to load wordlist firmware: %d\n", ret);
+		wl = ERR_PTR(ret);
+	} else {
+		wl = mock_accel_parse_wordlist(dev, fw);
+	}
+
+	mock_accel_fw_load_record(ktime_get_ns() - start, !IS_ERR(wl));
+	return wl;
+}
+
+static void mock_accel_wordlist_release(struct kref *ref)
+{
+	struct mock_accel_wordlist *wl = container_of(ref, struct mock_accel_wordlist, ref);
+
+	/* Wait for generators that picked this wordlist up before the swap */
+	synchronize_rcu();
+
+	release_firmware(wl->fw);
+	kvfree(wl);
+}
+
+static struct mock_accel_wordlist *mock_accel_wordlist_get(struct mock_accel_wordlist *wl)
+{
+	if (wl)
+		kref_get(&wl->ref);
+	return wl;
+}
+
+static void mock_accel_wordlist_put(struct mock_accel_wordlist *wl)
+{
+	if (wl)
+		kref_put(&wl->ref, mock_accel_wordlist_release);
 }
 
 /*
- * Free wordlist resources
+ * Make wl the current wordlist and switch every device over to it.
+ * Generators keep running against the old version until they drop the
+ * RCU read lock; it is freed once the last device lets go of it. Returns
+ * the previous wordlist for the caller to put. Caller holds
+ * mock_accel_lock.
  */
-static void mock_accel_free_wordlist(struct mock_accel_dev *mdev)
+static struct mock_accel_wordlist *mock_accel_publish_wordlist(struct mock_accel_wordlist *wl)
 {
-	size_t i;
+	struct mock_accel_wordlist *old = mock_accel_wordlist;
+	struct mock_accel_dev *mdev;
+
+	lockdep_assert_held(&mock_accel_lock);
+
+	mock_accel_wordlist = wl;
+
+	list_for_each_entry(mdev, &mock_accel_devices, node) {
+		struct mock_accel_wordlist *prev;
 
-	if (mdev->wordlist) {
-		for (i = 0; i < mdev->wordlist_count; i++)
-			kfree(mdev->wordlist[i]);
-		kfree(mdev->wordlist);
-		mdev->wordlist = NULL;
+		prev = rcu_replace_pointer(mdev->wordlist, mock_accel_wordlist_get(wl),
+					   lockdep_is_held(&mock_accel_lock));
+		/* Not the last reference: the module still holds old */
+		mock_accel_wordlist_put(prev);
 	}
 
-	if (mdev->wordlist_fw) {
-		release_firmware(mdev->wordlist_fw);
-		mdev->wordlist_fw = NULL;
+	return old;
+}
+
+/*
+ * request_firmware_nowait() completion for the first probe. Devices
+ * registered in the meantime have been running without a wordlist and
+ * pick this one up; blocked stream readers are woken.
+ */
+static void mock_accel_wordlist_fw_done(const struct firmware *fw, void *context)
+{
+	struct device *dev = context;
+	struct mock_accel_wordlist *wl, *old = NULL;
+
+	if (fw) {
+		wl = mock_accel_parse_wordlist(dev, fw);
+	} else {
+		dev_warn(dev, "Wordlist firmware not found (passphrase generation disabled)\n");
+		wl = ERR_PTR(-ENOENT);
 	}
 
-	mdev->wordlist_count = 0;
-	mdev->wordlist_loaded = false;
+	mutex_lock(&mock_accel_lock);
+	mock_accel_fw_pending = false;
+	mock_accel_fw_load_record(ktime_get_ns() - mock_accel_fw_start, !IS_ERR(wl));
+	/* A load_wordlist write may have installed one first */
+	if (!IS_ERR(wl))
+		old = mock_accel_wordlist ? wl : mock_accel_publish_wordlist(wl);
+	mutex_unlock(&mock_accel_lock);
+
+	mock_accel_wordlist_put(old);
+	if (!IS_ERR(wl))
+		wake_up_interruptible(&mock_accel_wordlist_wait);
 }
 
 /*
- * Generate passphrase using wordlist
+ * Register a device and give it a reference to the shared wordlist. If
+ * there is none yet, the firmware is requested asynchronously and the
+ * device works without passphrase generation until it arrives, so probe
+ * never waits for a firmware lookup.
  */
-static int mock_accel_generate_passphrase(struct mock_accel_dev *mdev,
-					   u8 word_count, char *output, size_t output_size)
+static int mock_accel_attach_wordlist(struct mock_accel_dev *mdev)
+{
+	struct device *dev = &mdev->pdev->dev;
+	int ret = 0;
+
+	mutex_lock(&mock_accel_lock);
+
+	rcu_assign_pointer(mdev->wordlist, mock_accel_wordlist_get(mock_accel_wordlist));
+	list_add_tail(&mdev->node, &mock_accel_devices);
+
+	if (!mock_accel_wordlist && !mock_accel_fw_pending) {
+		mock_accel_fw_start = ktime_get_ns();
+		ret = request_firmware_nowait(THIS_MODULE, true, MOCK_ACCEL_WORDLIST_FW,
+					      dev, GFP_KERNEL, dev,
+					      mock_accel_wordlist_fw_done);
+		mock_accel_fw_pending = !ret;
+	}
+
+	mutex_unlock(&mock_accel_lock);
+
+	return ret;
+}
+
+static void mock_accel_detach_wordlist(struct mock_accel_dev *mdev)
+{
+	struct mock_accel_wordlist *wl;
+
+	mutex_lock(&mock_accel_lock);
+	list_del(&mdev->node);
+	wl = rcu_replace_pointer(mdev->wordlist, NULL, lockdep_is_held(&mock_accel_lock));
+	mutex_unlock(&mock_accel_lock);
+
+	mock_accel_wordlist_put(wl);
+}
+
+/* Load the wordlist firmware again and switch every device over to it */
+static int mock_accel_reload_wordlist(struct device *dev)
+{
+	struct mock_accel_wordlist *wl, *old;
+
+	wl = mock_accel_load_wordlist(dev);
+	if (IS_ERR(wl))
+		return PTR_ERR(wl);
+
+	mutex_lock(&mock_accel_lock);
+	old = mock_accel_publish_wordlist(wl);
+	mutex_unlock(&mock_accel_lock);
+
+	wake_up_interruptible(&mock_accel_wordlist_wait);
+	mock_accel_wordlist_put(old);
+	return 0;
+}
+
+/*
+ * Build a NUL-terminated passphrase from wl for mdev. Returns its length
+ * or a negative errno. Caller holds rcu_read_lock().
+ */
+static int mock_accel_build_passphrase(struct mock_accel_dev *mdev,
+				       const struct mock_accel_wordlist *wl,
+				       u8 word_count, char separator,
+				       char *output, size_t output_size)
 {
 	u16 indices[MOCK_ACCEL_MAX_WORDS];
 	size_t i, offset = 0;
 
-	if (!mdev->wordlist || mdev->wordlist_count == 0)
-		return -ENOENT;
-
 	if (word_count == 0)
 		word_count = MOCK_ACCEL_DEFAULT_WORDS;
 
@@ -259,25 +738,137 @@ static int mock_accel_generate_passphrase(struct mock_accel_dev *mdev,
 		size_t word_len;
 
 		/* Map random u16 to wordlist index */
-		indices[i] = indices[i] % mdev->wordlist_count;
-		word = mdev->wordlist[indices[i]];
-		word_len = strlen(word);
+		indices[i] = indices[i] % wl->count;
+		word = wl->fw->data + wl->words[indices[i]].offset;
+		word_len = wl->words[indices[i]].len;
 
 		/* Check buffer space */
-		if (offset + word_len + 2 > output_size)  /* +2 for hyphen and null */
+		if (offset + word_len + 2 > output_size)  /* +2 for separator and null */
 			return -ENOSPC;
 
 		/* Append word */
 		memcpy(output + offset, word, word_len);
 		offset += word_len;
 
-		/* Add hyphen separator (except after last word) */
+		/* Add separator (except after last word) */
 		if (i < word_count - 1) {
-			output[offset++] = '-';
+			output[offset++] = separator;
 		}
 	}
 
 	output[offset] = '\0';
+
+	this_cpu_inc(mdev->stats->passphrases);
+	trace_mock_accel_passphrase(mdev->minor, word_count, offset);
+	return offset;
+}
+
+/*
+ * Generate passphrase using the device's wordlist
+ */
+static int mock_accel_generate_passphrase(struct mock_accel_dev *mdev,
+					   u8 word_count, char *output, size_t output_size)
+{
+	struct mock_accel_wordlist *wl;
+	int ret = -ENOENT;
+
+	rcu_read_lock();
+	wl = rcu_dereference(mdev->wordlist);
+	if (wl)
+		ret = mock_accel_build_passphrase(mdev, wl, word_count, '-', output, output_size);
+	rcu_read_unlock();
+
+	return ret < 0 ? ret : 0;
+}
+
+/*
+ * MOCK_ACCEL_IOC_PASSPHRASE_BATCH: fill a user buffer with passphrases,
+ * one page-sized chunk per RCU read section and copy_to_user()
+ */
+static long mock_accel_passphrase_batch(struct mock_accel_dev *mdev,
+					struct mock_accel_passphrase_batch __user *ubatch)
+{
+	struct mock_accel_passphrase_batch batch;
+	struct mock_accel_wordlist *wl;
+	char __user *dst;
+	char *chunk, separator;
+	u64 bytes = 0;
+	u32 done = 0;
+	long ret = 0;
+
+	if (copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+
+	if (batch.word_count > MOCK_ACCEL_MAX_WORDS || batch.reserved)
+		return -EINVAL;
+
+	separator = batch.separator ? batch.separator : '-';
+	dst = u64_to_user_ptr(batch.buf);
+	/* bytes is reported as a u32 */
+	batch.buf_len = min_t(u64, batch.buf_len, U32_MAX);
+
+	chunk = kmalloc(MOCK_ACCEL_BATCH_CHUNK, GFP_KERNEL);
+	if (!chunk)
+		return -ENOMEM;
+
+	while (done < batch.count) {
+		size_t fill = 0;
+		u32 n = 0;
+
+		rcu_read_lock();
+		wl = rcu_dereference(mdev->wordlist);
+		if (!wl) {
+			rcu_read_unlock();
+			ret = -ENOENT;
+			break;
+		}
+		while (done + n < batch.count) {
+			size_t room = min_t(u64, MOCK_ACCEL_BATCH_CHUNK - fill,
+					    batch.buf_len - bytes - fill);
+			int len;
+
+			len = mock_accel_build_passphrase(mdev, wl, batch.word_count, separator,
+							  chunk + fill, room);
+			if (len < 0)
+				break;
+			fill += len + 1;
+			n++;
+		}
+		rcu_read_unlock();
+
+		/* An empty chunk means the user buffer is full */
+		if (!fill) {
+			if (!done)
+				ret = -ENOSPC;
+			break;
+		}
+
+		if (copy_to_user(dst + bytes, chunk, fill)) {
+			ret = -EFAULT;
+			break;
+		}
+		bytes += fill;
+		done += n;
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+
+	kfree(chunk);
+
+	/* Report partial progress rather than failing a half-done batch */
+	if (done && ret != -EFAULT)
+		ret = 0;
+	if (ret)
+		return ret;
+
+	batch.generated = done;
+	batch.bytes = bytes;
+	if (copy_to_user(ubatch, &batch, sizeof(batch)))
+		return -EFAULT;
+
+	dev_dbg(&mdev->pdev->dev, "Generated %u passphrases (%llu bytes)\n", done, bytes);
 	return 0;
 }
 
@@ -287,9 +878,29 @@ static int mock_accel_generate_passphrase(struct mock_accel_dev *mdev,
 static int mock_accel_open(struct inode *inode, struct file *filp)
 {
 	struct mock_accel_dev *mdev;
+	struct mock_accel_file *file;
 
 	mdev = container_of(inode->i_cdev, struct mock_accel_dev, cdev);
-	filp->private_data = mdev;
+
+	file = kzalloc(sizeof(*file), GFP_KERNEL);
+	if (!file)
+		return -ENOMEM;
+	file->mdev = mdev;
+	mutex_init(&file->lock);
+
+	/* Default mode from the stream_words attribute, so plain cat/dd work */
+	file->stream_words = READ_ONCE(mdev->stream_words);
+	file->stream_separator = '-';
+	if (file->stream_words) {
+		file->chunk = kmalloc(MOCK_ACCEL_STREAM_CHUNK, GFP_KERNEL);
+		if (!file->chunk) {
+			kfree(file);
+			return -ENOMEM;
+		}
+		file->stream = true;
+	}
+
+	filp->private_data = file;
 
 	dev_dbg(&mdev->pdev->dev, "Device opened\n");
 	return 0;
@@ -297,17 +908,22 @@ static int mock_accel_open(struct inode *inode, struct file *filp)
 
 static int mock_accel_release(struct inode *inode, struct file *filp)
 {
-	struct mock_accel_dev *mdev = filp->private_data;
-	dev_dbg(&mdev->pdev->dev, "Device released\n");
+	struct mock_accel_file *file = filp->private_data;
+
+	dev_dbg(&file->mdev->pdev->dev, "Device released\n");
+	kfree(file->chunk);
+	vfree(file->ring);
+	kfree(file);
 	return 0;
 }
 
-static ssize_t mock_accel_read(struct file *filp, char __user *buf,
-			       size_t count, loff_t *f_pos)
+static ssize_t mock_accel_read_info(struct mock_accel_dev *mdev, char __user *buf,
+				    size_t count, loff_t *f_pos)
 {
-	struct mock_accel_dev *mdev = filp->private_data;
+	struct mock_accel_wordlist *wl;
 	char info[512];
 	char sample_passphrase[256];
+	size_t words;
 	int len, ret;
 
 	if (*f_pos > 0)
@@ -319,6 +935,11 @@ static ssize_t mock_accel_read(struct file *filp, char __user *buf,
 	if (ret)
 		snprintf(sample_passphrase, sizeof(sample_passphrase), "(firmware not loaded)");
 
+	rcu_read_lock();
+	wl = rcu_dereference(mdev->wordlist);
+	words = wl ? wl->count : 0;
+	rcu_read_unlock();
+
 	len = snprintf(info, sizeof(info),
 		       "Mock Accelerator Device\n"
 		       "UUID: %pUb\n"
@@ -329,9 +950,9 @@ static ssize_t mock_accel_read(struct file *filp, char __user *buf,
 		       "Sample Passphrase (6 words): %s\n",
 		       &mdev->uuid,
 		       mdev->memory_size,
-		       ioread32(mdev->bar0 + REG_STATUS),
+		       READ_ONCE(mdev->status),
 		       dev_to_node(&mdev->pdev->dev),
-		       mdev->wordlist_count,
+		       words,
 		       sample_passphrase);
 
 	if (count < len)
@@ -344,53 +965,464 @@ static ssize_t mock_accel_read(struct file *filp, char __user *buf,
 	return len;
 }
 
-static long mock_accel_ioctl(struct file *filp, unsigned int cmd,
-			     unsigned long arg)
+/*
+ * Refill file->chunk with as many newline-terminated passphrases as fit.
+ * Returns -EAGAIN if the device has no wordlist.
+ */
+static int mock_accel_stream_refill(struct mock_accel_file *file)
+{
+	struct mock_accel_wordlist *wl;
+	size_t fill = 0;
+	int len;
+
+	/* The longest possible passphrase must fit, or a refill could be empty */
+	BUILD_BUG_ON(MOCK_ACCEL_MAX_WORDS * (MOCK_ACCEL_MAX_WORD_LEN + 1) + 1 >
+		     MOCK_ACCEL_STREAM_CHUNK);
+
+	rcu_read_lock();
+	wl = rcu_dereference(file->mdev->wordlist);
+	if (!wl) {
+		rcu_read_unlock();
+		return -EAGAIN;
+	}
+	for (;;) {
+		len = mock_accel_build_passphrase(file->mdev, wl, file->stream_words,
+						  file->stream_separator, file->chunk + fill,
+						  MOCK_ACCEL_STREAM_CHUNK - fill);
+		if (len < 0)
+			break;
+		file->chunk[fill + len] = '\n';
+		fill += len + 1;
+	}
+	rcu_read_unlock();
+
+	file->chunk_off = 0;
+	file->chunk_len = fill;
+	return 0;
+}
+
+/*
+ * Streaming read: fill the whole user buffer. A passphrase cut off at the
+ * end of one read() is continued by the next, so the output is a clean
+ * newline-separated stream whatever the read size.
+ */
+static ssize_t mock_accel_read_stream(struct mock_accel_file *file, char __user *buf,
+				      size_t count, bool nonblock)
+{
+	size_t done = 0;
+	int ret = 0;
+
+	if (mutex_lock_interruptible(&file->lock))
+		return -ERESTARTSYS;
+
+	while (done < count) {
+		size_t n;
+
+		/* Streaming was switched off while we waited for the lock */
+		if (!file->chunk)
+			break;
+
+		if (file->chunk_off == file->chunk_len) {
+			if (done && signal_pending(current))
+				break;
+			cond_resched();
+
+			ret = mock_accel_stream_refill(file);
+			if (ret == -EAGAIN) {
+				/* No wordlist: return what we have, or wait for one */
+				if (done || nonblock)
+					break;
+				mutex_unlock(&file->lock);
+				if (wait_event_interruptible(mock_accel_wordlist_wait,
+						rcu_access_pointer(file->mdev->wordlist)))
+					return -ERESTARTSYS;
+				if (mutex_lock_interruptible(&file->lock))
+					return -ERESTARTSYS;
+				continue;
+			}
+		}
+
+		n = min(count - done, file->chunk_len - file->chunk_off);
+		if (copy_to_user(buf + done, file->chunk + file->chunk_off, n)) {
+			ret = -EFAULT;
+			break;
+		}
+		file->chunk_off += n;
+		done += n;
+	}
+
+	mutex_unlock(&file->lock);
+
+	if (done)
+		return done;
+	return ret;
+}
+
+static ssize_t mock_accel_read(struct file *filp, char __user *buf,
+			       size_t count, loff_t *f_pos)
+{
+	struct mock_accel_file *file = filp->private_data;
+
+	if (READ_ONCE(file->stream))
+		return mock_accel_read_stream(file, buf, count, filp->f_flags & O_NONBLOCK);
+
+	return mock_accel_read_info(file->mdev, buf, count, f_pos);
+}
+
+static __poll_t mock_accel_poll(struct file *filp, poll_table *wait)
+{
+	struct mock_accel_file *file = filp->private_data;
+
+	poll_wait(filp, &mock_accel_wordlist_wait, wait);
+
+	/* The banner is always readable; a stream once a wordlist exists */
+	if (!READ_ONCE(file->stream) || rcu_access_pointer(file->mdev->wordlist))
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+/*
+ * MOCK_ACCEL_IOC_STREAM: enter or leave streaming read mode
+ */
+static long mock_accel_set_stream(struct mock_accel_file *file,
+				  struct mock_accel_stream __user *ustream)
+{
+	struct mock_accel_stream stream;
+	char *chunk = NULL;
+
+	if (copy_from_user(&stream, ustream, sizeof(stream)))
+		return -EFAULT;
+
+	if (stream.word_count > MOCK_ACCEL_MAX_WORDS || stream.reserved)
+		return -EINVAL;
+
+	if (stream.enable) {
+		chunk = kmalloc(MOCK_ACCEL_STREAM_CHUNK, GFP_KERNEL);
+		if (!chunk)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&file->lock);
+
+	/* Drop any buffered output from the previous settings */
+	kfree(file->chunk);
+	file->chunk = chunk;
+	file->chunk_off = 0;
+	file->chunk_len = 0;
+	file->stream_words = stream.word_count;
+	file->stream_separator = stream.separator ? stream.separator : '-';
+	WRITE_ONCE(file->stream, !!stream.enable);
+
+	mutex_unlock(&file->lock);
+	return 0;
+}
+
+/*
+ * MOCK_ACCEL_IOC_RING_SETUP: allocate the result ring for mmap(). The ring
+ * can only be set up once per open file, as it may already be mapped.
+ */
+static long mock_accel_ring_setup(struct mock_accel_file *file,
+				  struct mock_accel_ring_setup __user *usetup)
+{
+	struct mock_accel_ring_setup setup;
+	struct mock_accel_ring *ring;
+	size_t size;
+
+	if (copy_from_user(&setup, usetup, sizeof(setup)))
+		return -EFAULT;
+
+	if (!setup.nr_slots || setup.nr_slots > MOCK_ACCEL_RING_MAX_SLOTS ||
+	    !is_power_of_2(setup.nr_slots) ||
+	    setup.word_count > MOCK_ACCEL_MAX_WORDS || setup.reserved)
+		return -EINVAL;
+
+	size = PAGE_ALIGN(PAGE_SIZE + (size_t)setup.nr_slots * MOCK_ACCEL_RING_SLOT_SIZE);
+
+	mutex_lock(&file->lock);
+
+	if (file->ring) {
+		mutex_unlock(&file->lock);
+		return -EBUSY;
+	}
+
+	/* Zeroed and suitable for remap_vmalloc_range() */
+	ring = vmalloc_user(size);
+	if (!ring) {
+		mutex_unlock(&file->lock);
+		return -ENOMEM;
+	}
+	ring->nr_slots = setup.nr_slots;
+	ring->slot_size = MOCK_ACCEL_RING_SLOT_SIZE;
+	ring->data_offset = PAGE_SIZE;
+
+	file->ring_size = size;
+	file->ring_slots = setup.nr_slots;
+	file->ring_head = 0;
+	file->ring_words = setup.word_count;
+	file->ring_separator = setup.separator ? setup.separator : '-';
+	/* Pairs with the acquire in mock_accel_mmap(), which takes no lock */
+	smp_store_release(&file->ring, ring);
+
+	mutex_unlock(&file->lock);
+
+	setup.mmap_size = size;
+	if (copy_to_user(usetup, &setup, sizeof(setup)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/*
+ * MOCK_ACCEL_IOC_RING_FILL: generate passphrases into every free slot and
+ * publish them by advancing head. Returns the number of slots filled.
+ */
+static long mock_accel_ring_fill(struct mock_accel_file *file)
+{
+	struct mock_accel_wordlist *wl;
+	struct mock_accel_ring *ring;
+	char *slots;
+	u32 head, tail, mask;
+	long filled = 0;
+	int ret = 0;
+
+	mutex_lock(&file->lock);
+
+	ring = file->ring;
+	if (!ring) {
+		mutex_unlock(&file->lock);
+		return -EINVAL;
+	}
+
+	slots = (char *)ring + PAGE_SIZE;
+	mask = file->ring_slots - 1;
+	head = file->ring_head;
+	tail = smp_load_acquire(&ring->tail);
+
+	/* tail comes from user space: never trust it past head */
+	if (head - tail > mask + 1) {
+		mutex_unlock(&file->lock);
+		return -EINVAL;
+	}
+
+	while (head - tail <= mask) {
+		u32 n = 0;
+
+		rcu_read_lock();
+		wl = rcu_dereference(file->mdev->wordlist);
+		if (!wl) {
+			rcu_read_unlock();
+			ret = -ENOENT;
+			break;
+		}
+		while (head - tail <= mask && n < MOCK_ACCEL_RING_FILL_BATCH) {
+			ret = mock_accel_build_passphrase(file->mdev, wl, file->ring_words,
+							  file->ring_separator,
+							  slots + (size_t)(head & mask) * MOCK_ACCEL_RING_SLOT_SIZE,
+							  MOCK_ACCEL_RING_SLOT_SIZE);
+			if (ret < 0)
+				break;
+			head++;
+			n++;
+		}
+		rcu_read_unlock();
+
+		/* Make the slot contents visible before the new head */
+		smp_store_release(&ring->head, head);
+		file->ring_head = head;
+		filled += n;
+
+		if (ret < 0 || fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+
+	mutex_unlock(&file->lock);
+
+	if (!filled && ret < 0)
+		return ret;
+	return filled;
+}
+
+/*
+ * Map (part of) the device memory BAR. It is prefetchable memory, so map
+ * it write-combining as the PCI core does for resourceN_wc.
+ */
+static int mock_accel_mmap_memory(struct mock_accel_dev *mdev,
+				  struct vm_area_struct *vma)
+{
+	if (!mdev->mem_bar_size)
+		return -ENODEV;
+
+	/* vm_iomap_memory() takes vm_pgoff as the offset into the BAR */
+	vma->vm_pgoff -= MOCK_ACCEL_MMAP_MEMORY >> PAGE_SHIFT;
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
+	return vm_iomap_memory(vma, pci_resource_start(mdev->pdev, MEMORY_BAR),
+			       mdev->mem_bar_size);
+}
+
+static int mock_accel_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct mock_accel_file *file = filp->private_data;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct mock_accel_ring *ring;
+
+	if (vma->vm_pgoff >= MOCK_ACCEL_MMAP_MEMORY >> PAGE_SHIFT)
+		return mock_accel_mmap_memory(file->mdev, vma);
+	if (vma->vm_pgoff != 0)
+		return -EINVAL;
+
+	/*
+	 * No file->lock: mmap() runs under mmap_lock, and a stream read
+	 * holds file->lock across copy_to_user(), which can fault and take
+	 * mmap_lock. The ring is published once and freed on release.
+	 */
+	ring = smp_load_acquire(&file->ring);
+	if (!ring || size > file->ring_size)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring, 0);
+}
+
+/*
+ * MOCK_ACCEL_IOC_PASSPHRASE: generate one passphrase into *upass
+ */
+static long mock_accel_passphrase_one(struct mock_accel_dev *mdev,
+				      struct mock_accel_passphrase __user *upass)
 {
-	struct mock_accel_dev *mdev = filp->private_data;
 	struct mock_accel_passphrase pass;
-	u32 status;
 	int ret;
 
+	if (copy_from_user(&pass, upass, sizeof(pass)))
+		return -EFAULT;
+
+	/* Validate word count */
+	if (pass.word_count > MOCK_ACCEL_MAX_WORDS)
+		return -EINVAL;
+
+	/* Generate passphrase */
+	ret = mock_accel_generate_passphrase(mdev, pass.word_count,
+					     pass.passphrase, sizeof(pass.passphrase));
+	if (ret)
+		return ret;
+
+	if (copy_to_user(upass, &pass, sizeof(pass)))
+		return -EFAULT;
+
+	dev_dbg(&mdev->pdev->dev, "Generated %u-word passphrase\n",
+		pass.word_count ? pass.word_count : MOCK_ACCEL_DEFAULT_WORDS);
+	return 0;
+}
+
+static long mock_accel_do_ioctl(struct file *filp, unsigned int cmd,
+				unsigned long arg)
+{
+	struct mock_accel_file *file = filp->private_data;
+	struct mock_accel_dev *mdev = file->mdev;
+	u32 status;
+
 	switch (cmd) {
 	case MOCK_ACCEL_IOC_STATUS:
-		status = ioread32(mdev->bar0 + REG_STATUS);
+		status = READ_ONCE(mdev->status);
 		if (copy_to_user((u32 __user *)arg, &status, sizeof(status)))
 			return -EFAULT;
 		return 0;
 
 	case MOCK_ACCEL_IOC_PASSPHRASE:
-		if (copy_from_user(&pass, (void __user *)arg, sizeof(pass)))
-			return -EFAULT;
+		return mock_accel_passphrase_one(mdev, (void __user *)arg);
 
-		/* Validate word count */
-		if (pass.word_count > MOCK_ACCEL_MAX_WORDS)
-			return -EINVAL;
+	case MOCK_ACCEL_IOC_PASSPHRASE_BATCH:
+		return mock_accel_passphrase_batch(mdev, (void __user *)arg);
 
-		/* Generate passphrase */
-		ret = mock_accel_generate_passphrase(mdev, pass.word_count,
-						     pass.passphrase, sizeof(pass.passphrase));
-		if (ret)
-			return ret;
+	case MOCK_ACCEL_IOC_STREAM:
+		return mock_accel_set_stream(file, (void __user *)arg);
 
-		if (copy_to_user((void __user *)arg, &pass, sizeof(pass)))
-			return -EFAULT;
+	case MOCK_ACCEL_IOC_RING_SETUP:
+		return mock_accel_ring_setup(file, (void __user *)arg);
 
-		dev_dbg(&mdev->pdev->dev, "Generated %u-word passphrase\n",
-			pass.word_count ? pass.word_count : MOCK_ACCEL_DEFAULT_WORDS);
-		return 0;
+	case MOCK_ACCEL_IOC_RING_FILL:
+		return mock_accel_ring_fill(file);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+static long mock_accel_ioctl(struct file *filp, unsigned int cmd,
+			     unsigned long arg)
+{
+	struct mock_accel_file *file = filp->private_data;
+	struct mock_accel_dev *mdev = file->mdev;
+	u64 start;
+	long ret;
+
+	trace_mock_accel_ioctl_enter(mdev->minor, cmd);
+	start = ktime_get_ns();
+
+	ret = mock_accel_do_ioctl(filp, cmd, arg);
+
+	mock_accel_hist_add(&mdev->stats->ioctl, ktime_get_ns() - start);
+	if (ret < 0)
+		this_cpu_inc(mdev->stats->ioctl_errors);
+	trace_mock_accel_ioctl_exit(mdev->minor, cmd, ret);
+	return ret;
+}
+
+#ifdef MOCK_ACCEL_HAVE_URING_CMD
+static const void *mock_accel_uring_payload(struct io_uring_cmd *ioucmd)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+	return io_uring_sqe_cmd(ioucmd->sqe);
+#else
+	return ioucmd->cmd;
+#endif
+}
+
+/*
+ * io_uring passthrough. Requests complete inline: a single passphrase is
+ * cheap, and a large batch issued non-blocking returns -EAGAIN so io_uring
+ * retries it from an io-wq worker, keeping the submitting thread free to
+ * drive other devices.
+ */
+static int mock_accel_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+	struct mock_accel_file *file = ioucmd->file->private_data;
+	const struct mock_accel_uring_cmd *cmd = mock_accel_uring_payload(ioucmd);
+	void __user *arg = u64_to_user_ptr(READ_ONCE(cmd->arg));
+	struct mock_accel_passphrase_batch __user *ubatch = arg;
+	u32 count;
+
+	switch (ioucmd->cmd_op) {
+	case MOCK_ACCEL_IOC_PASSPHRASE:
+		return mock_accel_passphrase_one(file->mdev, arg);
+
+	case MOCK_ACCEL_IOC_PASSPHRASE_BATCH:
+		if (issue_flags & IO_URING_F_NONBLOCK) {
+			if (get_user(count, &ubatch->count))
+				return -EFAULT;
+			if (count > MOCK_ACCEL_URING_INLINE_BATCH)
+				return -EAGAIN;
+		}
+		return mock_accel_passphrase_batch(file->mdev, ubatch);
 
 	default:
 		return -ENOTTY;
 	}
 }
+#endif
 
 static const struct file_operations mock_accel_fops = {
 	.owner = THIS_MODULE,
 	.open = mock_accel_open,
 	.release = mock_accel_release,
 	.read = mock_accel_read,
+	.poll = mock_accel_poll,
+	.mmap = mock_accel_mmap,
 	.unlocked_ioctl = mock_accel_ioctl,
+#ifdef MOCK_ACCEL_HAVE_URING_CMD
+	.uring_cmd = mock_accel_uring_cmd,
+#endif
 	.llseek = noop_llseek,
 };
 
@@ -418,6 +1450,18 @@ static ssize_t memory_size_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(memory_size);
 
+/*
+ * sysfs attribute: memory_bar_size (only with a device memory BAR)
+ */
+static ssize_t memory_bar_size_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%llu\n", (unsigned long long)mdev->mem_bar_size);
+}
+static DEVICE_ATTR_RO(memory_bar_size);
+
 /*
  * sysfs attribute: capabilities
  */
@@ -438,10 +1482,7 @@ static ssize_t status_show(struct device *dev, struct device_attribute *attr,
 {
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
 
-	/* Re-read from hardware */
-	mdev->status = ioread32(mdev->bar0 + REG_STATUS);
-
-	return sprintf(buf, "0x%08x\n", mdev->status);
+	return sprintf(buf, "0x%08x\n", READ_ONCE(mdev->status));
 }
 
 static ssize_t status_store(struct device *dev, struct device_attribute *attr,
@@ -456,8 +1497,10 @@ static ssize_t status_store(struct device *dev, struct device_attribute *attr,
 		return ret;
 
 	/* Write to hardware */
-	iowrite32(val, mdev->bar0 + REG_STATUS);
-	mdev->status = val;
+	mutex_lock(&mdev->status_lock);
+	mock_accel_write32(mdev, REG_STATUS, val);
+	WRITE_ONCE(mdev->status, val);
+	mutex_unlock(&mdev->status_lock);
 
 	return count;
 }
@@ -476,6 +1519,46 @@ static ssize_t numa_node_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(numa_node);
 
+/*
+ * sysfs attribute: device_info (read-only)
+ *
+ * Every discovery field as key=value lines in one read, all from cached
+ * state: a rescan costs one open/read per device and no MMIO. New keys
+ * may be added; readers must skip ones they do not know.
+ */
+static ssize_t device_info_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
+	struct pci_dev *pdev = mdev->pdev;
+	int len = 0;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "uuid=%pUb\n", &mdev->uuid);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "memory_size=%llu\n",
+			 mdev->memory_size);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "memory_bar_size=%llu\n",
+			 (unsigned long long)mdev->mem_bar_size);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "capabilities=0x%08x\n",
+			 mdev->capabilities);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "status=0x%08x\n",
+			 READ_ONCE(mdev->status));
+	len += scnprintf(buf + len, PAGE_SIZE - len, "numa_node=%d\n",
+			 dev_to_node(&pdev->dev));
+	len += scnprintf(buf + len, PAGE_SIZE - len, "pci_address=%s\n", pci_name(pdev));
+	len += scnprintf(buf + len, PAGE_SIZE - len, "type=%s\n", mdev->is_vf ? "vf" : "pf");
+	if (mdev->is_vf && mdev->physfn)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "physfn=%s\n",
+				 pci_name(mdev->physfn));
+	else
+		len += scnprintf(buf + len, PAGE_SIZE - len, "sriov_totalvfs=%d\n",
+				 mdev->sriov_total_vfs);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "fw_version=0x%08x\n",
+			 mdev->fw_version);
+
+	return len;
+}
+static DEVICE_ATTR_RO(device_info);
+
 /*
  * sysfs attribute: sriov_totalvfs (PF only, read-only)
  */
@@ -560,7 +1643,7 @@ static ssize_t passphrase_length_show(struct device *dev,
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
 	u32 length;
 
-	length = ioread32(mdev->bar0 + REG_PASSPHRASE_LENGTH);
+	length = mock_accel_read32(mdev, REG_PASSPHRASE_LENGTH);
 	return sprintf(buf, "%u\n", length);
 }
 
@@ -579,7 +1662,7 @@ static ssize_t passphrase_length_store(struct device *dev,
 	if (length < 4 || length > 12)
 		return -EINVAL;
 
-	iowrite32(length, mdev->bar0 + REG_PASSPHRASE_LENGTH);
+	mock_accel_write32(mdev, REG_PASSPHRASE_LENGTH, length);
 	return count;
 }
 static DEVICE_ATTR_RW(passphrase_length);
@@ -592,6 +1675,7 @@ static ssize_t passphrase_generate_store(struct device *dev,
 					 const char *buf, size_t count)
 {
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
+	long left;
 	u32 cmd;
 	int ret;
 
@@ -599,11 +1683,29 @@ static ssize_t passphrase_generate_store(struct device *dev,
 	if (ret)
 		return ret;
 
-	if (cmd == 1) {
-		iowrite32(1, mdev->bar0 + REG_PASSPHRASE_CMD);
+	if (cmd != 1)
+		return count;
+
+	mutex_lock(&mdev->passphrase_lock);
+
+	if (mdev->nr_irqs)
+		reinit_completion(&mdev->passphrase_done);
+
+	mock_accel_write32(mdev, REG_PASSPHRASE_CMD, 1);
+
+	/* With MSI-X, sleep until the result is ready instead of polling */
+	if (mdev->nr_irqs) {
+		left = wait_for_completion_interruptible_timeout(&mdev->passphrase_done,
+				msecs_to_jiffies(MOCK_ACCEL_PASSPHRASE_TIMEOUT_MS));
+		if (left == 0)
+			ret = -ETIMEDOUT;
+		else if (left < 0)
+			ret = left;
 	}
 
-	return count;
+	mutex_unlock(&mdev->passphrase_lock);
+
+	return ret ? ret : count;
 }
 static DEVICE_ATTR_WO(passphrase_generate);
 
@@ -617,7 +1719,7 @@ static ssize_t passphrase_status_show(struct device *dev,
 	u32 status;
 	const char *status_str;
 
-	status = ioread32(mdev->bar0 + REG_PASSPHRASE_STATUS);
+	status = mock_accel_read32(mdev, REG_PASSPHRASE_STATUS);
 
 	switch (status) {
 	case 0: status_str = "idle"; break;
@@ -640,7 +1742,7 @@ static ssize_t passphrase_count_show(struct device *dev,
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
 	u32 count;
 
-	count = ioread32(mdev->bar0 + REG_PASSPHRASE_COUNT);
+	count = mock_accel_read32(mdev, REG_PASSPHRASE_COUNT);
 	return sprintf(buf, "%u\n", count);
 }
 static DEVICE_ATTR_RO(passphrase_count);
@@ -652,27 +1754,68 @@ static ssize_t passphrase_show(struct device *dev,
 			       struct device_attribute *attr, char *buf)
 {
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
+	u64 start = ktime_get_ns();
+	u32 len;
 	int i;
 
-	/* Read 256 bytes from passphrase buffer */
-	for (i = 0; i < 256; i++) {
-		buf[i] = ioread8(mdev->bar0 + REG_PASSPHRASE_BUFFER + i);
-	}
+	/*
+	 * Fetch only the bytes holding the result with word-sized accesses:
+	 * every access is a trip to the device emulation. Fall back to the
+	 * whole buffer if the device does not report the length.
+	 */
+	len = mock_accel_read32(mdev, REG_PASSPHRASE_BYTES);
+	if (len == 0 || len >= PASSPHRASE_BUFFER_SIZE)
+		len = PASSPHRASE_BUFFER_SIZE - 1;
+
+	mock_accel_read_block(mdev, REG_PASSPHRASE_BUFFER, buf, round_up(len + 1, 4));
 
 	/* Ensure null termination */
-	buf[255] = '\0';
+	buf[len] = '\0';
 
 	/* Find actual string length and add newline */
 	i = strlen(buf);
-	if (i < 255) {
-		buf[i++] = '\n';
-		buf[i] = '\0';
-	}
+	buf[i++] = '\n';
+	buf[i] = '\0';
 
+	mock_accel_hist_add(&mdev->stats->passphrase_read, ktime_get_ns() - start);
 	return i;
 }
 static DEVICE_ATTR_RO(passphrase);
 
+/*
+ * sysfs attribute: stream_words (read/write)
+ *
+ * Non-zero makes read() on newly opened /dev/mockN files return a stream
+ * of passphrases with this many words instead of the info banner.
+ */
+static ssize_t stream_words_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(mdev->stream_words));
+}
+
+static ssize_t stream_words_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
+	u8 words;
+	int ret;
+
+	ret = kstrtou8(buf, 0, &words);
+	if (ret)
+		return ret;
+
+	if (words > MOCK_ACCEL_MAX_WORDS)
+		return -EINVAL;
+
+	WRITE_ONCE(mdev->stream_words, words);
+	return count;
+}
+static DEVICE_ATTR_RW(stream_words);
+
 /*
  * sysfs attribute: fw_version (read-only)
  */
@@ -696,7 +1839,7 @@ static ssize_t wordlist_loaded_show(struct device *dev,
 {
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
 
-	return sprintf(buf, "%d\n", mdev->wordlist_loaded ? 1 : 0);
+	return sprintf(buf, "%d\n", rcu_access_pointer(mdev->wordlist) ? 1 : 0);
 }
 static DEVICE_ATTR_RO(wordlist_loaded);
 
@@ -707,16 +1850,23 @@ static ssize_t wordlist_size_show(struct device *dev,
 				  struct device_attribute *attr, char *buf)
 {
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
+	struct mock_accel_wordlist *wl;
+	size_t size;
 
-	if (!mdev->wordlist_fw)
-		return sprintf(buf, "0\n");
+	rcu_read_lock();
+	wl = rcu_dereference(mdev->wordlist);
+	size = wl ? wl->fw->size : 0;
+	rcu_read_unlock();
 
-	return sprintf(buf, "%zu\n", mdev->wordlist_fw->size);
+	return sprintf(buf, "%zu\n", size);
 }
 static DEVICE_ATTR_RO(wordlist_size);
 
 /*
  * sysfs attribute: load_wordlist (write-only, trigger firmware load)
+ *
+ * The wordlist is shared, so this reloads it for every device. On failure
+ * the devices keep the wordlist they had.
  */
 static ssize_t load_wordlist_store(struct device *dev,
 				   struct device_attribute *attr,
@@ -725,19 +1875,13 @@ static ssize_t load_wordlist_store(struct device *dev,
 	struct mock_accel_dev *mdev = dev_get_drvdata(dev);
 	int ret;
 
-	/* Free existing wordlist if loaded */
-	mock_accel_free_wordlist(mdev);
-
-	/* Load new wordlist */
-	ret = mock_accel_load_wordlist(mdev);
+	ret = mock_accel_reload_wordlist(&mdev->pdev->dev);
 	if (ret) {
 		dev_err(dev, "Failed to load wordlist firmware: %d\n", ret);
 		return ret;
 	}
 
-	mdev->wordlist_loaded = true;
-	dev_info(dev, "Reloaded wordlist firmware (%zu words)\n",
-		 mdev->wordlist_count);
+	dev_info(dev, "Reloaded wordlist firmware for all devices\n");
 
 	return count;
 }
@@ -746,9 +1890,11 @@ static DEVICE_ATTR_WO(load_wordlist);
 static struct attribute *mock_accel_attrs[] = {
 	&dev_attr_uuid.attr,
 	&dev_attr_memory_size.attr,
+	&dev_attr_memory_bar_size.attr,
 	&dev_attr_capabilities.attr,
 	&dev_attr_status.attr,
 	&dev_attr_numa_node.attr,
+	&dev_attr_device_info.attr,
 	&dev_attr_fw_version.attr,
 	&dev_attr_wordlist_loaded.attr,
 	&dev_attr_wordlist_size.attr,
@@ -760,6 +1906,7 @@ static struct attribute *mock_accel_attrs[] = {
 	&dev_attr_passphrase_status.attr,
 	&dev_attr_passphrase_count.attr,
 	&dev_attr_passphrase.attr,
+	&dev_attr_stream_words.attr,
 	NULL,
 };
 
@@ -776,6 +1923,9 @@ static umode_t mock_accel_attr_is_visible(struct kobject *kobj,
 			return 0;
 	}
 
+	if (attr == &dev_attr_memory_bar_size.attr && !mdev->mem_bar_size)
+		return 0;
+
 	return attr->mode;
 }
 
@@ -789,6 +1939,66 @@ static const struct attribute_group *mock_accel_groups[] = {
 	NULL,
 };
 
+/*
+ * debugfs: mock-accel/firmware_load and mock-accel/<device>/stats
+ */
+static void mock_accel_hist_show(struct seq_file *m, const char *name,
+				 const struct mock_accel_hist *hist)
+{
+	unsigned int i;
+
+	seq_printf(m, "%s_count %llu\n", name, hist->count);
+	seq_printf(m, "%s_sum_ns %llu\n", name, hist->sum_ns);
+	/* Empty buckets would make up most of the output */
+	for (i = 0; i < MOCK_ACCEL_HIST_BUCKETS; i++)
+		if (hist->buckets[i])
+			seq_printf(m, "%s_bucket_ns{ge=\"%llu\"} %llu\n",
+				   name, i ? 1ULL << i : 0, hist->buckets[i]);
+}
+
+static int mock_accel_stats_show(struct seq_file *m, void *unused)
+{
+	struct mock_accel_dev *mdev = m->private;
+	struct mock_accel_stats sum = {};
+	u64 *dst = (u64 *)&sum;
+	int cpu;
+	size_t i;
+
+	/* Every field is a u64 counter, so sum them as an array */
+	BUILD_BUG_ON(sizeof(sum) % sizeof(u64));
+	for_each_possible_cpu(cpu) {
+		const u64 *src = (const u64 *)per_cpu_ptr(mdev->stats, cpu);
+
+		for (i = 0; i < sizeof(sum) / sizeof(u64); i++)
+			dst[i] += src[i];
+	}
+
+	seq_printf(m, "mmio_reads %llu\n", sum.mmio_reads);
+	seq_printf(m, "mmio_writes %llu\n", sum.mmio_writes);
+	seq_printf(m, "passphrases %llu\n", sum.passphrases);
+	seq_printf(m, "ioctl_errors %llu\n", sum.ioctl_errors);
+	mock_accel_hist_show(m, "ioctl", &sum.ioctl);
+	mock_accel_hist_show(m, "passphrase_read", &sum.passphrase_read);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mock_accel_stats);
+
+static int mock_accel_firmware_load_show(struct seq_file *m, void *unused)
+{
+	struct mock_accel_hist hist;
+	u64 errors;
+
+	spin_lock(&mock_accel_fw_lock);
+	hist = mock_accel_fw_load;
+	errors = mock_accel_fw_errors;
+	spin_unlock(&mock_accel_fw_lock);
+
+	seq_printf(m, "firmware_load_errors %llu\n", errors);
+	mock_accel_hist_show(m, "firmware_load", &hist);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mock_accel_firmware_load);
+
 /*
  * PCI probe - called when device is discovered
  */
@@ -804,8 +2014,16 @@ static int mock_accel_probe(struct pci_dev *pdev,
 	if (!mdev)
 		return -ENOMEM;
 
+	mdev->stats = devm_alloc_percpu(&pdev->dev, struct mock_accel_stats);
+	if (!mdev->stats)
+		return -ENOMEM;
+
 	mdev->pdev = pdev;
+	mdev->minor = -1;
 	pci_set_drvdata(pdev, mdev);
+	init_completion(&mdev->passphrase_done);
+	mutex_init(&mdev->passphrase_lock);
+	mutex_init(&mdev->status_lock);
 
 	/* Enable PCI device */
 	ret = pci_enable_device(pdev);
@@ -814,6 +2032,9 @@ static int mock_accel_probe(struct pci_dev *pdev,
 		return ret;
 	}
 
+	/* MSI-X delivery requires bus mastering */
+	pci_set_master(pdev);
+
 	/* Request BAR0 */
 	ret = pci_request_region(pdev, 0, DRV_NAME);
 	if (ret) {
@@ -821,8 +2042,13 @@ static int mock_accel_probe(struct pci_dev *pdev,
 		goto err_disable;
 	}
 
-	/* Map BAR0 */
-	mdev->bar0 = pci_iomap(pdev, 0, BAR0_SIZE);
+	/* Map all of BAR0, including the info page if present */
+	if (pci_resource_len(pdev, 0) < BAR0_SIZE) {
+		dev_err(&pdev->dev, "BAR0 too small\n");
+		ret = -ENODEV;
+		goto err_release;
+	}
+	mdev->bar0 = pci_iomap(pdev, 0, 0);
 	if (!mdev->bar0) {
 		dev_err(&pdev->dev, "Failed to map BAR0\n");
 		ret = -ENOMEM;
@@ -832,6 +2058,23 @@ static int mock_accel_probe(struct pci_dev *pdev,
 	/* Read device attributes from registers */
 	read_device_attrs(mdev);
 
+	/* Device memory, mapped only by user space */
+	if ((mdev->capabilities & CAP_MEMORY_BAR) &&
+	    (pci_resource_flags(pdev, MEMORY_BAR) & IORESOURCE_MEM) &&
+	    pci_resource_len(pdev, MEMORY_BAR)) {
+		ret = pci_request_region(pdev, MEMORY_BAR, DRV_NAME);
+		if (ret) {
+			dev_err(&pdev->dev, "Failed to request BAR%d\n", MEMORY_BAR);
+			goto err_unmap;
+		}
+		mdev->mem_bar_size = pci_resource_len(pdev, MEMORY_BAR);
+	}
+
+	/* Completion interrupts */
+	ret = mock_accel_setup_irqs(mdev);
+	if (ret)
+		goto err_memory;
+
 	/* Detect SR-IOV support */
 	mdev->is_vf = pdev->is_virtfn;
 	mdev->sriov_num_vfs = 0;
@@ -857,6 +2100,8 @@ static int mock_accel_probe(struct pci_dev *pdev,
 
 	dev_info(&pdev->dev, "UUID: %pUb\n", &mdev->uuid);
 	dev_info(&pdev->dev, "Memory: %llu bytes\n", mdev->memory_size);
+	if (mdev->mem_bar_size)
+		dev_info(&pdev->dev, "Memory BAR: %pR\n", &pdev->resource[MEMORY_BAR]);
 	dev_info(&pdev->dev, "Capabilities: 0x%08x\n", mdev->capabilities);
 	dev_info(&pdev->dev, "NUMA node: %d\n", dev_to_node(&pdev->dev));
 
@@ -864,14 +2109,14 @@ static int mock_accel_probe(struct pci_dev *pdev,
 	minor = ida_alloc_max(&mock_accel_ida, MOCK_ACCEL_MAX_DEVICES - 1, GFP_KERNEL);
 	if (minor < 0) {
 		ret = minor;
-		goto err_unmap;
+		goto err_irqs;
 	}
 	mdev->minor = minor;
 
-	/* Load wordlist firmware */
-	ret = mock_accel_load_wordlist(mdev);
+	/* Share the wordlist; the first probe requests the firmware in the background */
+	ret = mock_accel_attach_wordlist(mdev);
 	if (ret) {
-		dev_warn(&pdev->dev, "Failed to load wordlist firmware: %d (passphrase generation disabled)\n", ret);
+		dev_warn(&pdev->dev, "Failed to request wordlist firmware: %d (passphrase generation disabled)\n", ret);
 		/* Non-fatal - device still functional without passphrase feature */
 	}
 
@@ -910,6 +2155,10 @@ static int mock_accel_probe(struct pci_dev *pdev,
 		goto err_device;
 	}
 
+	/* Errors are ignored: debugfs is optional */
+	mdev->debugfs = debugfs_create_dir(dev_name(mdev->class_dev), mock_accel_debugfs);
+	debugfs_create_file("stats", 0444, mdev->debugfs, mdev, &mock_accel_stats_fops);
+
 	dev_info(&pdev->dev, "Registered mock%d (UUID: %pUb, /dev/mock%d)\n",
 		 minor, &mdev->uuid, minor);
 
@@ -918,8 +2167,13 @@ static int mock_accel_probe(struct pci_dev *pdev,
 err_device:
 	cdev_del(&mdev->cdev);
 err_cdev:
-	mock_accel_free_wordlist(mdev);
+	mock_accel_detach_wordlist(mdev);
 	ida_free(&mock_accel_ida, minor);
+err_irqs:
+	mock_accel_free_irqs(mdev);
+err_memory:
+	if (mdev->mem_bar_size)
+		pci_release_region(pdev, MEMORY_BAR);
 err_unmap:
 	pci_iounmap(pdev, mdev->bar0);
 err_release:
@@ -938,6 +2192,8 @@ static void mock_accel_remove(struct pci_dev *pdev)
 
 	dev_info(&pdev->dev, "Removing mock%d\n", mdev->minor);
 
+	debugfs_remove_recursive(mdev->debugfs);
+
 	/* Disable SR-IOV if this is a PF with VFs enabled */
 	if (!mdev->is_vf && mdev->sriov_num_vfs > 0) {
 		pci_disable_sriov(pdev);
@@ -948,12 +2204,16 @@ static void mock_accel_remove(struct pci_dev *pdev)
 	device_destroy(mock_accel_class, MKDEV(MAJOR(mock_accel_devt), mdev->minor));
 	cdev_del(&mdev->cdev);
 
-	/* Free firmware resources */
-	mock_accel_free_wordlist(mdev);
+	/* Drop the shared wordlist */
+	mock_accel_detach_wordlist(mdev);
 
 	/* Release minor number */
 	ida_free(&mock_accel_ida, mdev->minor);
 
+	mock_accel_free_irqs(mdev);
+
+	if (mdev->mem_bar_size)
+		pci_release_region(pdev, MEMORY_BAR);
 	pci_iounmap(pdev, mdev->bar0);
 	pci_release_region(pdev, 0);
 	pci_disable_device(pdev);
@@ -971,6 +2231,8 @@ static struct pci_driver mock_accel_driver = {
 	.id_table = mock_accel_ids,
 	.probe = mock_accel_probe,
 	.remove = mock_accel_remove,
+	/* VFs enabled together probe in parallel */
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 };
 
 static int __init mock_accel_init(void)
@@ -1000,6 +2262,10 @@ static int __init mock_accel_init(void)
 		goto err_class;
 	}
 
+	mock_accel_debugfs = debugfs_create_dir(DRV_NAME, NULL);
+	debugfs_create_file("firmware_load", 0444, mock_accel_debugfs, NULL,
+			    &mock_accel_firmware_load_fops);
+
 	/* Register PCI driver */
 	ret = pci_register_driver(&mock_accel_driver);
 	if (ret) {
@@ -1011,6 +2277,7 @@ static int __init mock_accel_init(void)
 	return 0;
 
 err_pci:
+	debugfs_remove_recursive(mock_accel_debugfs);
 	class_destroy(mock_accel_class);
 err_class:
 	unregister_chrdev_region(mock_accel_devt, MOCK_ACCEL_MAX_DEVICES);
@@ -1020,6 +2287,8 @@ err_class:
 static void __exit mock_accel_exit(void)
 {
 	pci_unregister_driver(&mock_accel_driver);
+	debugfs_remove_recursive(mock_accel_debugfs);
+	mock_accel_wordlist_put(mock_accel_wordlist);
 	class_destroy(mock_accel_class);
 	unregister_chrdev_region(mock_accel_devt, MOCK_ACCEL_MAX_DEVICES);
 	ida_destroy(&mock_accel_ida);
@@ -1033,3 +2302,4 @@ MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Fabien Dupont");
 MODULE_DESCRIPTION("Mock Accelerator PCI Driver");
 MODULE_VERSION(DRV_VERSION);
+MODULE_FIRMWARE(MOCK_ACCEL_WORDLIST_FW);
@@ -15,8 +15,54 @@ struct mock_accel_passphrase {
     char passphrase[256];
 };
 
+struct mock_accel_passphrase_batch {
+    uint32_t count;
+    uint8_t word_count;
+    uint8_t separator;
+    uint16_t reserved;
+    uint64_t buf;
+    uint64_t buf_len;
+    uint32_t generated;
+    uint32_t bytes;
+};
+
 #define MOCK_ACCEL_IOC_STATUS _IOR(MOCK_ACCEL_IOC_MAGIC, 1, uint32_t)
 #define MOCK_ACCEL_IOC_PASSPHRASE _IOWR(MOCK_ACCEL_IOC_MAGIC, 2, struct mock_accel_passphrase)
+#define MOCK_ACCEL_IOC_PASSPHRASE_BATCH _IOWR(MOCK_ACCEL_IOC_MAGIC, 3, struct mock_accel_passphrase_batch)
+
+// Generate count passphrases with a single BATCH ioctl
+static int test_batch(int fd, uint8_t word_count, uint32_t count) {
+    struct mock_accel_passphrase_batch batch;
+    size_t buf_len = (size_t)count * 256;
+    char *buf, *p;
+    uint32_t i;
+
+    buf = malloc(buf_len);
+    if (!buf) {
+        perror("malloc");
+        return -1;
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.count = count;
+    batch.word_count = word_count;
+    batch.buf = (uintptr_t)buf;
+    batch.buf_len = buf_len;
+
+    if (ioctl(fd, MOCK_ACCEL_IOC_PASSPHRASE_BATCH, &batch) < 0) {
+        perror("ioctl(PASSPHRASE_BATCH)");
+        free(buf);
+        return -1;
+    }
+
+    printf("Generated %u passphrases (%u bytes):\n", batch.generated, batch.bytes);
+    for (i = 0, p = buf; i < batch.generated; i++, p += strlen(p) + 1) {
+        printf("  %s\n", p);
+    }
+
+    free(buf);
+    return 0;
+}
 
 int main(int argc, char **argv) {
     int fd;
@@ -24,8 +70,9 @@ int main(int argc, char **argv) {
     uint32_t status;
 
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <device> [word_count]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <device> [word_count] [count]\n", argv[0]);
         fprintf(stderr, "  word_count: 1-12 words (default: 6 if omitted)\n");
+        fprintf(stderr, "  count: passphrases to generate with one BATCH ioctl\n");
         return 1;
     }
 
@@ -42,6 +89,13 @@ int main(int argc, char **argv) {
         printf("Device status: 0x%08x\n", status);
     }
 
+    // Test PASSPHRASE_BATCH ioctl
+    if (argc > 3) {
+        int ret = test_batch(fd, atoi(argv[2]), strtoul(argv[3], NULL, 0));
+        close(fd);
+        return ret < 0 ? 1 : 0;
+    }
+
     // Test PASSPHRASE ioctl
     memset(&pass, 0, sizeof(pass));
     pass.word_count = (argc > 2) ? atoi(argv[2]) : 0;  // 0 = default (6)
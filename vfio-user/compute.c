@@ -0,0 +1,294 @@
+/*
+ * Mock Accelerator compute kernels
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "compute.h"
+
+/* ---- CRC32C ---- */
+
+#define CRC32C_POLY 0x82F63B78  /* Reflected Castagnoli polynomial */
+
+static uint32_t crc32c_table[256];
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    while (len--) {
+        crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t crc64 = crc;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+
+        memcpy(&v, p, sizeof(v));
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = (uint32_t)crc64;
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#define CRC32C_HW_NAME "sse4.2"
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t v;
+
+        memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#define CRC32C_HW_NAME "armv8-crc"
+#endif
+
+static uint32_t (*crc32c_fn)(uint32_t, const uint8_t *, size_t) = crc32c_sw;
+
+uint32_t compute_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    return ~crc32c_fn(~crc, buf, len);
+}
+
+const char *compute_crc32c_impl(void)
+{
+#ifdef CRC32C_HW_NAME
+    if (crc32c_fn == crc32c_hw) {
+        return CRC32C_HW_NAME;
+    }
+#endif
+    return "generic";
+}
+
+/* ---- XXH64 ---- */
+
+#define XXH_P1 0x9E3779B185EBCA87ULL
+#define XXH_P2 0xC2B2AE3D27D4EB4FULL
+#define XXH_P3 0x165667B19E3779F9ULL
+#define XXH_P4 0x85EBCA77C2B2AE63ULL
+#define XXH_P5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_P2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_P1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_P1 + XXH_P4;
+}
+
+/* Four independent lanes per 32-byte stripe */
+static void xxh64_stripe(uint64_t *v, const uint8_t *p)
+{
+    v[0] = xxh64_round(v[0], read64(p));
+    v[1] = xxh64_round(v[1], read64(p + 8));
+    v[2] = xxh64_round(v[2], read64(p + 16));
+    v[3] = xxh64_round(v[3], read64(p + 24));
+}
+
+void xxh64_init(struct xxh64_state *st, uint64_t seed)
+{
+    memset(st, 0, sizeof(*st));
+    st->seed = seed;
+    st->v[0] = seed + XXH_P1 + XXH_P2;
+    st->v[1] = seed + XXH_P2;
+    st->v[2] = seed;
+    st->v[3] = seed - XXH_P1;
+}
+
+void xxh64_update(struct xxh64_state *st, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    st->total_len += len;
+
+    if (st->buf_len + len < sizeof(st->buf)) {
+        memcpy(st->buf + st->buf_len, p, len);
+        st->buf_len += len;
+        return;
+    }
+
+    if (st->buf_len) {
+        size_t fill = sizeof(st->buf) - st->buf_len;
+
+        memcpy(st->buf + st->buf_len, p, fill);
+        xxh64_stripe(st->v, st->buf);
+        p += fill;
+        len -= fill;
+        st->buf_len = 0;
+    }
+
+    for (; len >= sizeof(st->buf); p += sizeof(st->buf), len -= sizeof(st->buf)) {
+        xxh64_stripe(st->v, p);
+    }
+
+    memcpy(st->buf, p, len);
+    st->buf_len = len;
+}
+
+uint64_t xxh64_digest(const struct xxh64_state *st)
+{
+    const uint8_t *p = st->buf;
+    size_t len = st->buf_len;
+    uint64_t h;
+
+    if (st->total_len >= sizeof(st->buf)) {
+        h = rotl64(st->v[0], 1) + rotl64(st->v[1], 7) +
+            rotl64(st->v[2], 12) + rotl64(st->v[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = xxh64_merge(h, st->v[i]);
+        }
+    } else {
+        h = st->seed + XXH_P5;
+    }
+    h += st->total_len;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * XXH_P1 + XXH_P4;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t)read32(p) * XXH_P1;
+        h = rotl64(h, 23) * XXH_P2 + XXH_P3;
+        p += 4;
+        len -= 4;
+    }
+    while (len--) {
+        h ^= *p++ * XXH_P5;
+        h = rotl64(h, 11) * XXH_P1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* ---- XOR parity ---- */
+
+static void xor_sw(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    for (; len >= 8; dst += 8, src += 8, len -= 8) {
+        uint64_t a, b;
+
+        memcpy(&a, dst, sizeof(a));
+        memcpy(&b, src, sizeof(b));
+        a ^= b;
+        memcpy(dst, &a, sizeof(a));
+    }
+    while (len--) {
+        *dst++ ^= *src++;
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static void xor_hw(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    for (; len >= 64; dst += 64, src += 64, len -= 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)dst);
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(dst + 32));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)src);
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(src + 32));
+
+        _mm256_storeu_si256((__m256i *)dst, _mm256_xor_si256(a0, b0));
+        _mm256_storeu_si256((__m256i *)(dst + 32), _mm256_xor_si256(a1, b1));
+    }
+    xor_sw(dst, src, len);
+}
+#define XOR_HW_NAME "avx2"
+#endif
+
+static void (*xor_fn)(uint8_t *, const uint8_t *, size_t) = xor_sw;
+
+void compute_xor(void *dst, const void *src, size_t len)
+{
+    xor_fn(dst, src, len);
+}
+
+const char *compute_xor_impl(void)
+{
+#ifdef XOR_HW_NAME
+    if (xor_fn == xor_hw) {
+        return XOR_HW_NAME;
+    }
+#endif
+    return "generic";
+}
+
+void compute_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+        }
+        crc32c_table[i] = crc;
+    }
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32c_fn = crc32c_hw;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        xor_fn = xor_hw;
+    }
+#elif defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        crc32c_fn = crc32c_hw;
+    }
+#endif
+}
@@ -0,0 +1,49 @@
+/*
+ * Mock Accelerator compute kernels
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Checksum, hash and parity kernels run by the compute descriptors. Each
+ * has a portable implementation and, where the CPU has one, an
+ * accelerated variant selected once by compute_init().
+ *
+ * The checksums are incremental so a buffer that spans several guest
+ * memory regions can be fed one fragment at a time.
+ */
+
+#ifndef MOCK_ACCEL_COMPUTE_H
+#define MOCK_ACCEL_COMPUTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Select implementations for this CPU; call once before any kernel */
+void compute_init(void);
+
+/* Names of the selected implementations, for logging */
+const char *compute_crc32c_impl(void);
+const char *compute_xor_impl(void);
+
+/*
+ * CRC32C (Castagnoli). Pass 0 to start and the previous result to
+ * continue, like zlib's crc32().
+ */
+uint32_t compute_crc32c(uint32_t crc, const void *buf, size_t len);
+
+/* XXH64, fed incrementally */
+struct xxh64_state {
+    uint64_t total_len;
+    uint64_t v[4];
+    uint8_t buf[32];
+    uint32_t buf_len;
+    uint64_t seed;
+};
+
+void xxh64_init(struct xxh64_state *st, uint64_t seed);
+void xxh64_update(struct xxh64_state *st, const void *buf, size_t len);
+uint64_t xxh64_digest(const struct xxh64_state *st);
+
+/* XOR parity: dst[i] ^= src[i] */
+void compute_xor(void *dst, const void *src, size_t len);
+
+#endif /* MOCK_ACCEL_COMPUTE_H */
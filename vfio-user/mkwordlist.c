@@ -0,0 +1,53 @@
+/*
+ * Mock Accelerator wordlist compiler
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Converts the EFF text wordlist into the packed image that
+ * mock-accel-server maps read-only at startup, or with -c into C source
+ * that is linked into the server (make EMBED_WORDLIST=1).
+ *
+ * Usage:
+ *   ./mkwordlist [-c] <input.txt> <output>
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wordlist.h"
+
+int main(int argc, char *argv[])
+{
+    struct wordlist wl;
+    bool source = false;
+    int ret;
+
+    if (argc == 4 && strcmp(argv[1], "-c") == 0) {
+        source = true;
+        argv++;
+        argc--;
+    }
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s [-c] <input.txt> <output>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (wordlist_load_text(argv[1], &wl) < 0) {
+        fprintf(stderr, "Error: cannot load %s: %s\n", argv[1], strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    ret = source ? wordlist_write_source(&wl, argv[2]) : wordlist_write_image(&wl, argv[2]);
+    if (ret < 0) {
+        fprintf(stderr, "Error: cannot write %s: %s\n", argv[2], strerror(errno));
+        wordlist_free(&wl);
+        return EXIT_FAILURE;
+    }
+
+    printf("Wrote %u words to %s\n", wl.count, argv[2]);
+    wordlist_free(&wl);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,573 @@
+/*
+ * Mock Accelerator vfio-user client benchmark
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Connects to mock-accel-server sockets as a minimal vfio-user client, so
+ * the server's region handlers and event loop can be measured without
+ * QEMU, a guest or KVM. Each socket is driven by its own thread with one
+ * request in flight, like a vCPU trapping on MMIO:
+ *
+ *   read        REGION_READ of BAR0 at -o (default REG_DEVICE_ID)
+ *   write       REGION_WRITE of REG_PASSPHRASE_LENGTH
+ *   config      dword REGION_READs sweeping the whole config space
+ *   passphrase  PASSPHRASE_CMD, poll PASSPHRASE_STATUS, read the result
+ *
+ * Results are printed as one JSON object with ops/s and per-operation
+ * latency percentiles, from the histogram in ../bench.h.
+ *
+ * Usage:
+ *   ./mock-accel-bench [-m MODE] [-d SECONDS | -n OPS] <socket> [socket...]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "../bench.h"
+
+/* vfio-user protocol, see libvfio-user's docs/vfio-user.rst */
+#define VFIO_USER_VERSION               1
+#define VFIO_USER_DEVICE_GET_INFO       4
+#define VFIO_USER_DEVICE_GET_REGION_INFO 5
+#define VFIO_USER_REGION_READ           9
+#define VFIO_USER_REGION_WRITE          10
+
+#define VFIO_USER_F_TYPE_REPLY          1
+#define VFIO_USER_F_TYPE_MASK           0xf
+#define VFIO_USER_F_ERROR               (1 << 5)
+
+#define VFIO_USER_MAJOR                 0
+#define VFIO_USER_MINOR                 1
+
+struct vfio_user_header {
+    uint16_t msg_id;
+    uint16_t cmd;
+    uint32_t msg_size;   /* Including this header */
+    uint32_t flags;
+    uint32_t error_no;
+} __attribute__((packed));
+
+struct vfio_user_version {
+    uint16_t major;
+    uint16_t minor;
+    char json[];
+} __attribute__((packed));
+
+struct vfio_user_device_info {
+    uint32_t argsz;
+    uint32_t flags;
+    uint32_t num_regions;
+    uint32_t num_irqs;
+} __attribute__((packed));
+
+struct vfio_user_region_info {
+    uint32_t argsz;
+    uint32_t flags;
+    uint32_t index;
+    uint32_t cap_offset;
+    uint64_t size;
+    uint64_t offset;
+} __attribute__((packed));
+
+struct vfio_user_region_access {
+    uint64_t offset;
+    uint32_t region;
+    uint32_t count;
+    uint8_t data[];
+} __attribute__((packed));
+
+#define REGION_BAR0             0
+#define REGION_CONFIG           7
+
+/* BAR0 registers, see mock-accel-server.c */
+#define REG_DEVICE_ID           0x00
+#define REG_PASSPHRASE_CMD      0x100
+#define REG_PASSPHRASE_LENGTH   0x104
+#define REG_PASSPHRASE_STATUS   0x108
+#define REG_PASSPHRASE_BYTES    0x110
+#define REG_PASSPHRASE_BUFFER   0x200
+#define PASSPHRASE_BUFFER_SIZE  256
+#define PASSPHRASE_BUSY         1
+#define PASSPHRASE_READY        2
+
+#define MAX_SOCKETS             64
+#define MAX_ACCESS              4096
+
+enum mode { MODE_READ, MODE_WRITE, MODE_CONFIG, MODE_PASSPHRASE, NR_MODES };
+
+static const char *const mode_names[NR_MODES] = {
+    [MODE_READ]       = "read",
+    [MODE_WRITE]      = "write",
+    [MODE_CONFIG]     = "config",
+    [MODE_PASSPHRASE] = "passphrase",
+};
+
+static struct {
+    enum mode mode;
+    uint64_t offset;         /* read: BAR0 offset */
+    uint32_t size;           /* read: bytes per access */
+    uint32_t words;          /* write/passphrase: REG_PASSPHRASE_LENGTH value */
+    double duration;
+    uint64_t ops;            /* Per socket; 0: run for duration */
+    const char *sockets[MAX_SOCKETS];
+    int nr_sockets;
+} cfg = {
+    .mode = MODE_READ,
+    .offset = REG_DEVICE_ID,
+    .size = 4,
+    .words = 6,
+    .duration = 5.0,
+};
+
+struct client {
+    pthread_t thread;
+    const char *path;
+    int fd;
+    uint16_t msg_id;
+    uint64_t config_size;
+
+    /* Results */
+    uint64_t ops;
+    uint64_t messages;       /* Requests sent, > ops in passphrase mode */
+    uint64_t errors;
+    char error[128];
+    struct bench_hist lat;
+};
+
+static pthread_barrier_t start_barrier;
+static volatile bool stop;
+
+static int fail(struct client *c, const char *what, int err)
+{
+    if (!c->errors++) {
+        snprintf(c->error, sizeof(c->error), "%s: %s", what, strerror(err));
+    }
+    errno = err;
+    return -1;
+}
+
+static int send_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t ret = writev(fd, iov, iovcnt);
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+
+    while (len > 0) {
+        ssize_t ret = recv(fd, p, len, 0);
+
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            if (ret == 0) {
+                errno = ECONNRESET;
+            }
+            return -1;
+        }
+        p += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/*
+ * Send one command made of two parts and wait for its reply. The reply
+ * payload is stored in reply, up to reply_len bytes; anything beyond is
+ * read and dropped. Returns the payload length or -1.
+ */
+static ssize_t request(struct client *c, uint16_t cmd, const void *a, size_t a_len,
+                       const void *b, size_t b_len, void *reply, size_t reply_len)
+{
+    struct vfio_user_header hdr = {
+        .msg_id = ++c->msg_id,
+        .cmd = cmd,
+        .msg_size = sizeof(hdr) + a_len + b_len,
+    };
+    struct iovec iov[] = {
+        { .iov_base = &hdr, .iov_len = sizeof(hdr) },
+        { .iov_base = (void *)a, .iov_len = a_len },
+        { .iov_base = (void *)b, .iov_len = b_len },
+    };
+    size_t len;
+
+    c->messages++;
+    if (send_all(c->fd, iov, b_len ? 3 : 2) < 0 ||
+        recv_all(c->fd, &hdr, sizeof(hdr)) < 0) {
+        return fail(c, "socket", errno);
+    }
+    if ((hdr.flags & VFIO_USER_F_TYPE_MASK) != VFIO_USER_F_TYPE_REPLY ||
+        hdr.msg_id != c->msg_id || hdr.cmd != cmd || hdr.msg_size < sizeof(hdr)) {
+        return fail(c, "unexpected message", EPROTO);
+    }
+
+    len = hdr.msg_size - sizeof(hdr);
+    if (recv_all(c->fd, reply, len < reply_len ? len : reply_len) < 0) {
+        return fail(c, "socket", errno);
+    }
+    for (size_t left = len > reply_len ? len - reply_len : 0; left > 0;) {
+        char tmp[256];
+        size_t n = left < sizeof(tmp) ? left : sizeof(tmp);
+
+        if (recv_all(c->fd, tmp, n) < 0) {
+            return fail(c, "socket", errno);
+        }
+        left -= n;
+    }
+
+    if (hdr.flags & VFIO_USER_F_ERROR) {
+        return fail(c, mode_names[cfg.mode], hdr.error_no ? hdr.error_no : EIO);
+    }
+    return len < reply_len ? len : reply_len;
+}
+
+static int region_read(struct client *c, uint32_t region, uint64_t offset, void *buf,
+                       uint32_t count)
+{
+    struct vfio_user_region_access req = { .offset = offset, .region = region, .count = count };
+    struct {
+        struct vfio_user_region_access hdr;
+        uint8_t data[MAX_ACCESS];
+    } reply;
+    ssize_t ret = request(c, VFIO_USER_REGION_READ, &req, sizeof(req), NULL, 0,
+                          &reply, sizeof(reply.hdr) + count);
+
+    if (ret < 0) {
+        return -1;
+    }
+    if ((size_t)ret != sizeof(reply.hdr) + count || reply.hdr.count != count) {
+        return fail(c, "short read", EPROTO);
+    }
+    memcpy(buf, reply.data, count);
+    return 0;
+}
+
+static int region_write(struct client *c, uint32_t region, uint64_t offset,
+                        const void *buf, uint32_t count)
+{
+    struct vfio_user_region_access req = { .offset = offset, .region = region, .count = count };
+    struct vfio_user_region_access reply;
+    ssize_t ret = request(c, VFIO_USER_REGION_WRITE, &req, sizeof(req), buf, count,
+                          &reply, sizeof(reply));
+
+    if (ret < 0) {
+        return -1;
+    }
+    if ((size_t)ret != sizeof(reply) || reply.count != count) {
+        return fail(c, "short write", EPROTO);
+    }
+    return 0;
+}
+
+static int read32(struct client *c, uint64_t offset, uint32_t *value)
+{
+    return region_read(c, REGION_BAR0, offset, value, sizeof(*value));
+}
+
+static int write32(struct client *c, uint64_t offset, uint32_t value)
+{
+    return region_write(c, REGION_BAR0, offset, &value, sizeof(value));
+}
+
+/* Connect and negotiate, then look up what the benchmark needs */
+static int client_connect(struct client *c)
+{
+    static const char json[] = "{\"capabilities\":{\"max_msg_fds\":8}}";
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct vfio_user_version version = {
+        .major = VFIO_USER_MAJOR,
+        .minor = VFIO_USER_MINOR,
+    };
+    struct vfio_user_device_info info = { .argsz = sizeof(info) };
+    struct vfio_user_region_info region = {
+        .argsz = sizeof(region),
+        .index = REGION_CONFIG,
+    };
+    char reply[1024];
+
+    if (strlen(c->path) >= sizeof(addr.sun_path)) {
+        return fail(c, c->path, ENAMETOOLONG);
+    }
+    strcpy(addr.sun_path, c->path);
+
+    c->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) {
+        return fail(c, "socket", errno);
+    }
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        return fail(c, c->path, errno);
+    }
+
+    if (request(c, VFIO_USER_VERSION, &version, sizeof(version), json, sizeof(json),
+                reply, sizeof(reply)) < 0 ||
+        request(c, VFIO_USER_DEVICE_GET_INFO, &info, sizeof(info), NULL, 0,
+                &info, sizeof(info)) < (ssize_t)sizeof(info) ||
+        request(c, VFIO_USER_DEVICE_GET_REGION_INFO, &region, sizeof(region), NULL, 0,
+                &region, sizeof(region)) < (ssize_t)sizeof(region)) {
+        if (!c->errors) {
+            fail(c, "negotiation", EPROTO);
+        }
+        return -1;
+    }
+    c->config_size = region.size;
+    if (c->config_size < 4) {
+        return fail(c, "config space", ENODEV);
+    }
+
+    /* Setup traffic is not part of the results */
+    c->messages = 0;
+    return 0;
+}
+
+/* One passphrase: doorbell, poll until done, fetch the result */
+static int run_passphrase(struct client *c)
+{
+    char buf[PASSPHRASE_BUFFER_SIZE];
+    uint32_t status, bytes;
+
+    if (write32(c, REG_PASSPHRASE_CMD, 1) < 0) {
+        return -1;
+    }
+    do {
+        if (read32(c, REG_PASSPHRASE_STATUS, &status) < 0) {
+            return -1;
+        }
+    } while (status == PASSPHRASE_BUSY);
+    if (status != PASSPHRASE_READY) {
+        return fail(c, "passphrase", EIO);
+    }
+
+    if (read32(c, REG_PASSPHRASE_BYTES, &bytes) < 0) {
+        return -1;
+    }
+    if (bytes >= sizeof(buf)) {
+        bytes = sizeof(buf) - 1;
+    }
+    return region_read(c, REGION_BAR0, REG_PASSPHRASE_BUFFER, buf, (bytes + 4) & ~3u);
+}
+
+static void *client_main(void *arg)
+{
+    struct client *c = arg;
+    uint8_t buf[MAX_ACCESS];
+    uint64_t config_off = 0;
+    int ret = client_connect(c);
+
+    bench_hist_init(&c->lat);
+    if (ret == 0 && cfg.mode == MODE_PASSPHRASE) {
+        ret = write32(c, REG_PASSPHRASE_LENGTH, cfg.words);
+        c->messages = 0;
+    }
+
+    /* Everyone starts together so main can time the run */
+    pthread_barrier_wait(&start_barrier);
+
+    while (ret == 0 && !stop && (!cfg.ops || c->ops < cfg.ops)) {
+        uint64_t start = bench_now_ns();
+
+        switch (cfg.mode) {
+        case MODE_READ:
+            ret = region_read(c, REGION_BAR0, cfg.offset, buf, cfg.size);
+            break;
+        case MODE_WRITE:
+            ret = write32(c, REG_PASSPHRASE_LENGTH, cfg.words);
+            break;
+        case MODE_CONFIG:
+            ret = region_read(c, REGION_CONFIG, config_off, buf, 4);
+            config_off = (config_off + 4) % c->config_size;
+            break;
+        case MODE_PASSPHRASE:
+        default:
+            ret = run_passphrase(c);
+            break;
+        }
+        if (ret == 0) {
+            bench_record(&c->lat, bench_now_ns() - start);
+            c->ops++;
+        }
+    }
+
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    return NULL;
+}
+
+static void report(const struct client *clients, double elapsed)
+{
+    static struct bench_hist lat;
+    uint64_t ops = 0, messages = 0, errors = 0;
+
+    bench_hist_init(&lat);
+    printf("{\"mode\":\"%s\",", mode_names[cfg.mode]);
+    if (cfg.mode == MODE_READ) {
+        printf("\"offset\":%" PRIu64 ",\"size\":%u,", cfg.offset, cfg.size);
+    } else if (cfg.mode != MODE_CONFIG) {
+        printf("\"words\":%u,", cfg.words);
+    }
+
+    printf("\"sockets\":[");
+    for (int i = 0; i < cfg.nr_sockets; i++) {
+        const struct client *c = &clients[i];
+
+        printf("%s{\"path\":", i ? "," : "");
+        bench_json_string(c->path);
+        printf(",\"ops\":%" PRIu64 ",\"ops_per_sec\":%.1f,\"errors\":%" PRIu64, c->ops,
+               c->ops / elapsed, c->errors);
+        if (c->errors) {
+            printf(",\"error\":");
+            bench_json_string(c->error);
+        }
+        printf("}");
+
+        ops += c->ops;
+        messages += c->messages;
+        errors += c->errors;
+        bench_hist_merge(&lat, &c->lat);
+    }
+
+    printf("],\"elapsed_s\":%.6f,\"ops\":%" PRIu64 ",\"ops_per_sec\":%.1f,"
+           "\"messages\":%" PRIu64 ",\"messages_per_sec\":%.1f,\"errors\":%" PRIu64,
+           elapsed, ops, ops / elapsed, messages, messages / elapsed, errors);
+    bench_json_latency(&lat);
+    printf("}\n");
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS] <socket_path> [socket_path...]\n", prog);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -m MODE     read, write, config or passphrase (default: read)\n");
+    fprintf(stderr, "  -d SECONDS  Run time (default: 5)\n");
+    fprintf(stderr, "  -n OPS      Stop after OPS operations per socket instead\n");
+    fprintf(stderr, "  -o OFFSET   read: BAR0 offset (default: 0, DEVICE_ID)\n");
+    fprintf(stderr, "  -s SIZE     read: bytes per access, 1-%d (default: 4)\n", MAX_ACCESS);
+    fprintf(stderr, "  -w WORDS    write/passphrase: passphrase length (default: 6)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "One thread per socket, one request in flight each. Prints one JSON\n");
+    fprintf(stderr, "object with ops/s and p50/p99/p999 latency.\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    struct client *clients;
+    uint64_t start, errors = 0;
+    double elapsed;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:d:n:o:s:w:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            for (cfg.mode = 0; cfg.mode < NR_MODES; cfg.mode++) {
+                if (strcmp(optarg, mode_names[cfg.mode]) == 0) {
+                    break;
+                }
+            }
+            if (cfg.mode == NR_MODES) {
+                fprintf(stderr, "Error: unknown mode '%s'\n", optarg);
+                usage(argv[0]);
+            }
+            break;
+        case 'd':
+            cfg.duration = atof(optarg);
+            break;
+        case 'n':
+            cfg.ops = strtoull(optarg, NULL, 0);
+            break;
+        case 'o':
+            cfg.offset = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            cfg.size = strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            cfg.words = strtoul(optarg, NULL, 0);
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (optind >= argc || argc - optind > MAX_SOCKETS) {
+        usage(argv[0]);
+    }
+    if (cfg.size < 1 || cfg.size > MAX_ACCESS || (!cfg.ops && cfg.duration <= 0)) {
+        fprintf(stderr, "Error: invalid option value\n");
+        usage(argv[0]);
+    }
+
+    clients = calloc(argc - optind, sizeof(*clients));
+    if (!clients) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    for (int i = optind; i < argc; i++) {
+        struct client *c = &clients[cfg.nr_sockets];
+
+        cfg.sockets[cfg.nr_sockets++] = argv[i];
+        c->path = argv[i];
+        c->fd = -1;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, cfg.nr_sockets + 1);
+    for (int i = 0; i < cfg.nr_sockets; i++) {
+        if (pthread_create(&clients[i].thread, NULL, client_main, &clients[i]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    start = bench_now_ns();
+
+    if (!cfg.ops) {
+        bench_sleep(cfg.duration);
+        stop = true;
+    }
+
+    for (int i = 0; i < cfg.nr_sockets; i++) {
+        pthread_join(clients[i].thread, NULL);
+        errors += clients[i].errors;
+    }
+    elapsed = (bench_now_ns() - start) / 1e9;
+
+    report(clients, elapsed);
+    free(clients);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -8,14 +8,46 @@
  *
  * Usage:
  *   ./mock-accel-server [-v] [-u UUID] [-m MEMORY_SIZE] <socket_path>
+ *   ./mock-accel-server [-v] --device SPEC [--device SPEC ...]
+ *   ./mock-accel-server [-v] --config FILE
  *
  * Example:
  *   ./mock-accel-server -u MOCK-0001 -m 16G /tmp/mock0.sock
  *
  *   qemu-system-x86_64 ... \
  *     -device vfio-user-pci,socket=/tmp/mock0.sock
+ *
+ * In multi-device mode a single process serves every listed device. Each
+ * vfio-user context runs in non-blocking mode and all poll fds are
+ * multiplexed with epoll, so a PF and its VFs share one event loop and one
+ * copy of the wordlist.
+ *
+ * Device commands (passphrase generation) can be offloaded to a pool of
+ * worker threads with --workers/--cpus. Each device is bound to one worker,
+ * so the message loop never blocks on command execution.
+ *
+ * BAR0 page 1 mirrors the identity and passphrase registers, backed by a
+ * memfd and offered to the client as a sparse mmap area, so guests read
+ * device info without trapping to this server.
+ *
+ * With --memory-bar the device memory (-m) also exists: BAR2 is backed by a
+ * memfd, optionally on hugetlbfs, that the client maps directly. Pages are
+ * populated on first touch unless --prefault is given.
+ *
+ * --numa-node pins every thread to the CPUs of one node and binds all
+ * memory, including the BAR2 pages that guest accesses fault in, to it.
+ *
+ * --stats-socket serves per-register access counters and command latency
+ * histograms in the Prometheus text format, without the cost of -v.
+ *
+ * Devices support live migration with pre-copy of BAR2, see "Live
+ * migration" below.
+ *
+ * With --persistent a client disconnect resets the device and the server
+ * waits for the next client on the same socket instead of exiting.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,10 +58,20 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/random.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <linux/mempolicy.h>
 
 #include "libvfio-user.h"
+#include "compute.h"
+#include "stats.h"
+#include "wordlist.h"
 
 /* PCI IDs */
 #define MOCK_ACCEL_VENDOR_ID    0x1de5
@@ -52,10 +94,82 @@
 #define REG_PASSPHRASE_LENGTH  0x104  /* 4 bytes, RW - num words (4-12) */
 #define REG_PASSPHRASE_STATUS  0x108  /* 4 bytes, RO - 0=idle, 1=busy, 2=ready, 3=error */
 #define REG_PASSPHRASE_COUNT   0x10C  /* 4 bytes, RO - words generated */
+#define REG_PASSPHRASE_BYTES   0x110  /* 4 bytes, RO - result length, excluding NUL */
+#define REG_PASSPHRASE_BATCH   0x114  /* 4 bytes, RW - results per command, 0=single */
 #define REG_PASSPHRASE_BUFFER  0x200  /* 256 bytes, RO - passphrase output */
 
+/*
+ * BAR0 Register Offsets - Descriptor Ring
+ *
+ * The guest places an array of struct mock_accel_desc in its own memory,
+ * programs base and size, fills descriptors and writes the new producer
+ * index to REG_RING_HEAD. The device processes descriptors between
+ * REG_RING_TAIL and REG_RING_HEAD through DMA, writes each result into the
+ * guest buffer, completes the descriptor in place and advances the tail.
+ * Indices are free-running 32-bit counters; the slot is index % size.
+ */
+#define REG_RING_BASE_LO   0x140  /* 4 bytes, RW - ring IOVA, 64-byte aligned */
+#define REG_RING_BASE_HI   0x144  /* 4 bytes, RW */
+#define REG_RING_SIZE      0x148  /* 4 bytes, RW - descriptors, power of 2, 0=off */
+#define REG_RING_HEAD      0x14C  /* 4 bytes, RW - producer index (doorbell) */
+#define REG_RING_TAIL      0x150  /* 4 bytes, RO - consumer index */
+#define REG_RING_STATUS    0x154  /* 4 bytes, RO - 0=idle, 1=busy, 3=error */
+
+/*
+ * BAR0 MSI-X table and PBA. QEMU emulates these ranges itself, so they
+ * never reach bar0_access().
+ */
+#define MSIX_TABLE_OFFSET  0xE00
+#define MSIX_PBA_OFFSET    0xF00
+
+/* MSI-X vectors */
+#define MSIX_VEC_PASSPHRASE 0  /* REG_PASSPHRASE_CMD completed */
+#define MSIX_VEC_RING       1  /* Descriptor ring drained */
+#define MSIX_NR_VECTORS     2
+
+/*
+ * BAR0 page 1 - info page. A copy of BAR0 offsets 0x000-0x2FF (identity,
+ * passphrase registers and buffer) at the same relative offsets; the ring
+ * registers are not mirrored. BAR0 is a read/write region, so the guest
+ * maps the page writable too: a store to it is not a register write, is
+ * never read back, and lasts until the next update rewrites the mirrored
+ * ranges. REG_PASSPHRASE_STATUS is updated last, so a guest that sees
+ * READY also sees the matching buffer.
+ */
+#define INFO_PAGE_OFFSET   0x1000
+#define INFO_PAGE_SIZE     0x1000
+
+/*
+ * BAR0 page 2 - result window (CAP_RESULT_WINDOW). With REG_PASSPHRASE_BATCH
+ * set to N, one REG_PASSPHRASE_CMD fills slots 0..N-1 and clears the rest;
+ * slot 0 is also copied to REG_PASSPHRASE_BUFFER. Mapped like the info
+ * page, so it is guest-writable as well; the server only reads slots back
+ * for migration, and the next command rewrites all of them. Slots are
+ * valid once REG_PASSPHRASE_STATUS leaves BUSY.
+ */
+#define RESULT_WINDOW_OFFSET 0x2000
+#define RESULT_SLOTS         16
+#define RESULT_SLOT_SIZE     256
+
+/* Pages 1-2 are backed by a memfd mapped into the guest */
+#define MAPPED_OFFSET      INFO_PAGE_OFFSET
+#define MAPPED_SIZE        (INFO_PAGE_SIZE + RESULT_SLOTS * RESULT_SLOT_SIZE)
+
 /* BAR0 size */
-#define BAR0_SIZE          0x1000  /* 4KB */
+#define BAR0_SIZE          0x4000  /* 16KB: registers, info page, result window */
+
+/*
+ * BAR2 - device memory. The BAR is the memory size rounded up to a power
+ * of two, capped to what a 32-bit memory BAR can reasonably claim.
+ */
+#define MEMORY_BAR_MIN_SIZE 0x1000
+#define MEMORY_BAR_MAX_SIZE (1ULL << 30)  /* 1GB */
+#define HUGEPAGE_SIZE       (2ULL << 20)  /* MFD_HUGETLB default page size */
+
+/* Device memory backing (mock_accel_state.mem_bar) */
+#define MEM_BAR_NONE       0
+#define MEM_BAR_MEMFD      1
+#define MEM_BAR_HUGETLB    2
 
 /* Magic values */
 #define DEVICE_ID_MAGIC    0x4B434F4D  /* "MOCK" in little-endian */
@@ -64,6 +178,11 @@
 
 /* Capability flags */
 #define CAP_COMPUTE        (1 << 0)
+#define CAP_RING           (1 << 1)  /* Descriptor ring in guest memory */
+#define CAP_INFO_PAGE      (1 << 2)  /* Mappable info page at INFO_PAGE_OFFSET */
+#define CAP_MEMORY_BAR     (1 << 3)  /* Device memory in BAR2 */
+#define CAP_DMA_ENGINE     (1 << 4)  /* COPY/FILL/COMPARE descriptors */
+#define CAP_RESULT_WINDOW  (1 << 5)  /* REG_PASSPHRASE_BATCH and result window */
 
 /* Status flags */
 #define STATUS_READY       (1 << 0)
@@ -72,6 +191,122 @@
 #define DEFAULT_MEMORY_SIZE (16ULL * 1024 * 1024 * 1024)  /* 16GB */
 #define DEFAULT_VF_MEMORY_SIZE (2ULL * 1024 * 1024 * 1024)  /* 2GB */
 #define MAX_VFS 7  /* PCIe allows functions 0-7, so max 7 VFs with PF at 0 */
+#define MAX_DEVICES 256  /* Devices served by one process */
+#define WORDLIST_SIZE 7776  /* Words in the EFF large wordlist */
+#define MAX_WORKERS 64
+#define MAX_NUMA_NODES 1024
+
+/* Entropy pool refilled in bulk; one refill covers several hundred passphrases */
+#define ENTROPY_POOL_SIZE 4096
+
+/* Passphrase engine status values (REG_PASSPHRASE_STATUS) */
+#define PASSPHRASE_IDLE    0
+#define PASSPHRASE_BUSY    1
+#define PASSPHRASE_READY   2
+#define PASSPHRASE_ERROR   3
+
+/* Descriptor ring limits */
+#define RING_MAX_SIZE      4096
+#define DMA_MAX_SGS        16  /* Guest buffer fragments per transfer */
+#define DMA_SG_DST         1   /* dma_sg slots: descriptor, dst, src */
+#define DMA_SG_SRC         (DMA_SG_DST + DMA_MAX_SGS)
+#define DMA_SG_COUNT       (DMA_SG_SRC + DMA_MAX_SGS)
+
+/* Descriptor opcodes */
+#define DESC_OP_PASSPHRASE 0x0001
+#define DESC_OP_COPY       0x0002  /* dst_len bytes from src_addr to dst_addr */
+#define DESC_OP_FILL       0x0003  /* dst_len bytes of the 8-byte pattern */
+#define DESC_OP_COMPARE    0x0004  /* dst_len bytes at src_addr and dst_addr */
+#define DESC_OP_CRC32C     0x0005  /* CRC32C of dst_len bytes at src_addr */
+#define DESC_OP_XXH64      0x0006  /* XXH64 of dst_len bytes at src_addr */
+#define DESC_OP_XOR        0x0007  /* dst_addr ^= src_addr over dst_len bytes */
+
+/* Descriptor status, written by the device on completion */
+#define DESC_STATUS_PENDING 0
+#define DESC_STATUS_DONE    1
+#define DESC_STATUS_ERROR   2
+
+/*
+ * Ring descriptor (64 bytes, little-endian). The guest fills the input
+ * fields and sets status to DESC_STATUS_PENDING; the device writes
+ * result_len and then status.
+ *
+ * For the DMA engine and compute opcodes dst_len is the transfer length
+ * and result_len the bytes processed; COMPARE stops at the first
+ * difference, so result_len == dst_len means the buffers are equal.
+ * CRC32C and XXH64 read only the source, take their seed from pattern
+ * (0 for the standard CRC32C) and return the checksum in result.
+ */
+struct mock_accel_desc {
+    uint16_t opcode;      /* DESC_OP_* */
+    uint8_t word_count;   /* Passphrase words (4-12) */
+    uint8_t separator;    /* Word separator, 0 = space */
+    uint32_t status;      /* DESC_STATUS_* (device-written) */
+    uint64_t dst_addr;    /* Result buffer IOVA */
+    uint32_t dst_len;     /* Result buffer size */
+    uint32_t result_len;  /* Bytes written, excluding NUL (device-written) */
+    uint64_t src_addr;    /* COPY/COMPARE source IOVA */
+    uint64_t pattern;     /* FILL pattern, repeated in memory order; hash seed */
+    uint64_t result;      /* CRC32C/XXH64 value (device-written) */
+    uint64_t reserved[2];
+} __attribute__((packed));
+
+_Static_assert(sizeof(struct mock_accel_desc) == 64, "descriptor must be 64 bytes");
+
+/* Result window slot, little-endian */
+struct result_slot {
+    uint32_t status;       /* PASSPHRASE_IDLE, _READY or _ERROR */
+    uint32_t bytes;        /* strlen(text) */
+    uint32_t words;
+    uint32_t reserved;
+    char text[RESULT_SLOT_SIZE - 16];  /* NUL-terminated */
+};
+
+_Static_assert(sizeof(struct result_slot) == RESULT_SLOT_SIZE, "result slot must be 256 bytes");
+_Static_assert(MAPPED_OFFSET + MAPPED_SIZE <= BAR0_SIZE, "result window outside BAR0");
+
+/* Register slots in struct device_stats, see stat_reg() */
+enum {
+    STAT_DEVICE_ID, STAT_REVISION, STAT_UUID, STAT_MEMORY_SIZE, STAT_CAPABILITIES,
+    STAT_STATUS, STAT_FW_VERSION, STAT_PASSPHRASE_CMD, STAT_PASSPHRASE_LENGTH,
+    STAT_PASSPHRASE_STATUS, STAT_PASSPHRASE_COUNT, STAT_PASSPHRASE_BYTES,
+    STAT_PASSPHRASE_BUFFER, STAT_RING_BASE, STAT_RING_SIZE, STAT_RING_HEAD,
+    STAT_RING_TAIL, STAT_RING_STATUS, STAT_INFO_PAGE, STAT_OTHER, STAT_CONFIG,
+    STAT_BAR2, STAT_PASSPHRASE_BATCH, STAT_RESULT_WINDOW, STAT_NR_REGS
+};
+
+static const char *const stat_reg_names[STAT_NR_REGS] = {
+    [STAT_DEVICE_ID]         = "device_id",
+    [STAT_REVISION]          = "revision",
+    [STAT_UUID]              = "uuid",
+    [STAT_MEMORY_SIZE]       = "memory_size",
+    [STAT_CAPABILITIES]      = "capabilities",
+    [STAT_STATUS]            = "status",
+    [STAT_FW_VERSION]        = "fw_version",
+    [STAT_PASSPHRASE_CMD]    = "passphrase_cmd",
+    [STAT_PASSPHRASE_LENGTH] = "passphrase_length",
+    [STAT_PASSPHRASE_STATUS] = "passphrase_status",
+    [STAT_PASSPHRASE_COUNT]  = "passphrase_count",
+    [STAT_PASSPHRASE_BYTES]  = "passphrase_bytes",
+    [STAT_PASSPHRASE_BUFFER] = "passphrase_buffer",
+    [STAT_RING_BASE]         = "ring_base",
+    [STAT_RING_SIZE]         = "ring_size",
+    [STAT_RING_HEAD]         = "ring_head",
+    [STAT_RING_TAIL]         = "ring_tail",
+    [STAT_RING_STATUS]       = "ring_status",
+    [STAT_INFO_PAGE]         = "info_page",
+    [STAT_OTHER]             = "other",
+    [STAT_CONFIG]            = "config_space",
+    [STAT_BAR2]              = "memory_bar",
+    [STAT_PASSPHRASE_BATCH]  = "passphrase_batch",
+    [STAT_RESULT_WINDOW]     = "result_window",
+};
+
+_Static_assert(STAT_NR_REGS <= STATS_MAX_REGS, "too many register stats");
+
+/* Pending work bits (mock_accel_state.jobs) */
+#define JOB_PASSPHRASE     (1 << 0)
+#define JOB_RING           (1 << 1)
 
 /* SR-IOV Extended Capability */
 #define PCI_EXT_CAP_ID_SRIOV  0x10
@@ -85,13 +320,100 @@
 #define PCI_SRIOV_VF_STRIDE   0x16  /* VF Stride */
 #define PCI_SRIOV_VF_DID      0x1a  /* VF Device ID */
 
-/* Server state */
+struct worker;
+
+/*
+ * Migration stream: a sequence of records, each a struct migr_record
+ * followed by len payload bytes. MIGR_REC_MEMORY carries BAR2 bytes at
+ * offset; MIGR_REC_DEVICE carries struct migr_device_state and ends the
+ * stream.
+ */
+#define MIGR_MAGIC         0x5347494d  /* "MIGS" */
+#define MIGR_VERSION       1
+#define MIGR_REC_MEMORY    1
+#define MIGR_REC_DEVICE    2
+
+#define MIGR_DEV_VF        (1 << 0)
+
+struct migr_record {
+    uint32_t type;
+    uint32_t len;
+    uint64_t offset;
+};
+
+/*
+ * Device state, little-endian. New versions only append fields; a shorter
+ * blob leaves the fields it lacks zeroed.
+ */
+struct migr_device_state {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;                   /* sizeof() on the sender */
+    uint32_t flags;                  /* MIGR_DEV_* */
+    uint8_t uuid[16];
+    uint64_t memory_size;
+    uint64_t mem_bar_size;
+    uint32_t status;
+    uint32_t passphrase_length;
+    uint32_t passphrase_status;
+    uint32_t passphrase_count;
+    uint32_t passphrase_bytes;
+    uint32_t passphrase_batch;
+    uint64_t ring_base;
+    uint32_t ring_size;
+    uint32_t ring_head;
+    uint32_t ring_tail;
+    uint32_t ring_status;
+    char passphrase_buffer[256];
+    struct result_slot results[RESULT_SLOTS];
+    uint8_t config[PCI_CFG_SPACE_SIZE];           /* PF only */
+    uint8_t sriov_cap[PCI_EXT_CAP_SRIOV_SIZEOF];  /* PF only */
+} __attribute__((packed));
+
+/* Migration progress, only touched on the event loop thread */
+struct migration {
+    vfu_migr_state_t state;
+    size_t page_size;
+    size_t nr_pages;                 /* BAR2 pages, 0 without --memory-bar */
+    uint64_t *sent;                  /* Hash of each page as last sent, 0: never */
+    unsigned char *resident;         /* mincore() vector of the current pass */
+    char *page;                      /* Copy of the page being sent */
+    uint64_t zero_hash;
+    size_t next_page;                /* Scan position of the current pass */
+    size_t pass_pages;               /* Pages sent by the current pass */
+    bool pass_active;
+    bool device_done;                /* Device state sent or received */
+    struct migr_record rec;          /* Record being sent or received */
+    size_t rec_done;                 /* Bytes of it transferred, header included */
+    struct migr_device_state dev;
+};
+
+/* Per-device state */
 struct mock_accel_state {
+    /* vfio-user context */
+    vfu_ctx_t *vfu_ctx;
+    char socket_path[PATH_MAX];
+    int poll_fd;         /* fd currently registered with epoll */
+    bool attached;       /* Client connected */
+    bool memory_size_set;
+
     /* Device properties */
     char uuid[64];
     uint64_t memory_size;
     uint32_t capabilities;
 
+    /* Mapping of BAR0 pages 1-2, a memfd shared with the client */
+    int info_fd;
+    char *info_page;
+    struct result_slot *results;     /* Page 2, inside the same mapping */
+
+    /* Device memory in BAR2, a memfd shared with the client */
+    int mem_bar;         /* MEM_BAR_* */
+    bool mem_prefault;   /* Populate at startup instead of on first touch */
+    int mem_fd;
+    char *mem;
+    uint64_t mem_bar_size;
+
     /* Runtime state */
     uint32_t status;
 
@@ -102,19 +424,111 @@ struct mock_accel_state {
     bool is_vf;          /* True if this is a VF, false if PF */
     uint16_t total_vfs;  /* Total VFs supported (PF only) */
     uint16_t vf_index;   /* VF index (0-based, only for VFs) */
-    uint8_t sriov_cap[64];  /* SR-IOV capability structure */
+    uint8_t sriov_cap[PCI_EXT_CAP_SRIOV_SIZEOF];  /* SR-IOV capability structure */
     size_t sriov_cap_size;  /* Size of SR-IOV capability */
 
-    /* Passphrase Generator */
-    char *wordlist[7776];           /* Loaded EFF wordlist */
+    /*
+     * PF config space image served by config_space_access(), built once
+     * the context is realized. config_wmask has the bits guest writes may
+     * change. Only touched on the event loop thread.
+     */
+    uint8_t config[PCI_CFG_SPACE_EXP_SIZE];
+    uint8_t config_wmask[PCI_CFG_SPACE_EXP_SIZE];
+    uint8_t config_default[PCI_CFG_SPACE_EXP_SIZE];  /* Restored for a new client */
+
+    /* Passphrase Generator, protected by lock */
+    pthread_mutex_t lock;
     char passphrase_buffer[256];     /* Generated passphrase output */
     uint32_t passphrase_length;      /* Configured word count (4-12) */
     uint32_t passphrase_status;      /* 0=idle, 1=busy, 2=ready, 3=error */
     uint32_t passphrase_count;       /* Actual words in generated passphrase */
+    uint32_t passphrase_bytes;       /* strlen() of passphrase_buffer */
+    uint32_t passphrase_batch;       /* Results per command, 0=single */
+
+    /* Descriptor ring, protected by lock */
+    uint64_t ring_base;
+    uint32_t ring_size;
+    uint32_t ring_head;
+    uint32_t ring_tail;
+    uint32_t ring_status;
+
+    /* DMA; dma_lock is held while guest memory is in use */
+    pthread_mutex_t dma_lock;
+    dma_sg_t *dma_sg;                /* Scratch: DMA_SG_COUNT entries */
+    bool dma_paused;                 /* Quiesced, protected by lock */
+
+    /* Command execution */
+    struct worker *worker;           /* NULL: execute on the event loop */
+    struct mock_accel_state *job_next;  /* Worker queue link */
+    uint32_t jobs;                   /* JOB_* bits pending execution */
+    uint32_t job_length;             /* Word count latched at submission */
+    uint32_t job_batch;              /* Batch size latched at submission */
+    uint64_t job_seq;                /* Bumped on reset to drop stale results */
+    uint64_t job_submitted_ns;       /* When the passphrase command was posted */
+    uint32_t job_runs;               /* run_jobs() calls queued or running */
+    pthread_cond_t idle;             /* Signalled when job_runs drops to 0 */
+
+    /* Live migration */
+    struct migration migr;
+
+    /* Access counters and latency histograms, see stats.h */
+    struct device_stats stats;
+};
+
+/*
+ * Command worker. Each device is bound to one worker, so its commands run
+ * in submission order on the same (optionally pinned) thread while the
+ * vfio-user message loop keeps serving region accesses.
+ */
+struct worker {
+    pthread_t thread;
+    int index;
+    int cpu;                         /* -1: not pinned */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct mock_accel_state *head;   /* FIFO of devices with a pending command */
+    struct mock_accel_state *tail;
+    bool stop;
 };
 
 static volatile bool running = true;
 
+/* --persistent: serve the next client after a disconnect instead of exiting */
+static bool persistent;
+
+/* --numa-node binding; numa_node < 0: none */
+static int numa_node = -1;
+static unsigned long numa_nodemask[MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+
+/*
+ * Wordlist files looked up next to the executable, then in vfio-user/ and
+ * the working directory. The compiled image (see mkwordlist) is preferred:
+ * it is mapped read-only and shared through the page cache by every server
+ * process on the host.
+ */
+static const char *const wordlist_names[] = {
+    "mock-accel-wordlist.bin",
+    "eff_large_wordlist.txt",
+};
+
+/* EFF wordlist, shared read-only by every device in this process */
+static struct wordlist wordlist;
+
+/*
+ * Random bytes for word selection. Each thread that generates passphrases
+ * (a worker, or the event loop when there is no pool) consumes its own
+ * buffer without locking or syscalls until it runs dry.
+ */
+struct entropy_pool {
+    uint8_t buf[ENTROPY_POOL_SIZE];
+    size_t pos;
+};
+
+static __thread struct entropy_pool entropy = { .pos = ENTROPY_POOL_SIZE };
+
+static int urandom_fd = -1;
+static pthread_once_t urandom_once = PTHREAD_ONCE_INIT;
+
 static void signal_handler(int sig)
 {
     (void)sig;
@@ -142,117 +556,193 @@ static void parse_uuid(struct mock_accel_state *state)
     }
 }
 
-static int load_wordlist(struct mock_accel_state *state)
+static void open_urandom(void)
 {
-    FILE *fp = fopen("vfio-user/eff_large_wordlist.txt", "r");
-    if (!fp) {
-        /* Try alternate path for when running from different directory */
-        fp = fopen("eff_large_wordlist.txt", "r");
-        if (!fp) {
-            fprintf(stderr, "Error: cannot open EFF wordlist file\n");
-            return -1;
+    urandom_fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+}
+
+/*
+ * Refill the pool with one getrandom() call, falling back to /dev/urandom
+ * (opened once per process) if the kernel pool is unavailable.
+ */
+static int entropy_refill(struct entropy_pool *pool)
+{
+    size_t filled = 0;
+
+    while (filled < sizeof(pool->buf)) {
+        ssize_t ret = getrandom(pool->buf + filled, sizeof(pool->buf) - filled,
+                                GRND_NONBLOCK);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        filled += ret;
+    }
+
+    if (filled < sizeof(pool->buf)) {
+        pthread_once(&urandom_once, open_urandom);
+        while (urandom_fd >= 0 && filled < sizeof(pool->buf)) {
+            ssize_t ret = read(urandom_fd, pool->buf + filled, sizeof(pool->buf) - filled);
+            if (ret <= 0) {
+                if (ret < 0 && errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            filled += ret;
         }
     }
 
-    char line[128];
-    int word_count = 0;
+    if (filled < sizeof(pool->buf)) {
+        return -1;
+    }
 
-    while (fgets(line, sizeof(line), fp) && word_count < 7776) {
-        /* Skip dice roll prefix (5 digits + tab) */
-        char *word = strchr(line, '\t');
-        if (!word) {
-            continue;
+    pool->pos = 0;
+    return 0;
+}
+
+/*
+ * Draw a uniformly distributed word index (0 to count-1) from the pool.
+ * Draws at or above the largest multiple of count that fits in 16 bits are
+ * rejected so that every word is equally likely.
+ */
+static int entropy_word_index(struct entropy_pool *pool, uint32_t count, uint16_t *index)
+{
+    const uint32_t limit = 65536 - (65536 % count);
+
+    for (;;) {
+        uint16_t value;
+
+        if (pool->pos + sizeof(value) > sizeof(pool->buf) && entropy_refill(pool) < 0) {
+            return -1;
         }
-        word++;  /* Skip tab character */
+        memcpy(&value, pool->buf + pool->pos, sizeof(value));
+        pool->pos += sizeof(value);
 
-        /* Remove newline */
-        char *newline = strchr(word, '\n');
-        if (newline) {
-            *newline = '\0';
+        if (value < limit) {
+            *index = value % count;
+            return 0;
         }
+    }
+}
 
-        /* Allocate and store word */
-        state->wordlist[word_count] = strdup(word);
-        if (!state->wordlist[word_count]) {
-            fprintf(stderr, "Error: memory allocation failed for wordlist\n");
-            fclose(fp);
+/*
+ * Find the first readable wordlist file in the search path
+ */
+static int find_wordlist(char *path, size_t size)
+{
+    char exe_dir[PATH_MAX];
+    const char *dirs[] = { exe_dir, "vfio-user", "." };
+    ssize_t len;
+
+    len = readlink("/proc/self/exe", exe_dir, sizeof(exe_dir) - 1);
+    if (len > 0) {
+        exe_dir[len] = '\0';
+        *strrchr(exe_dir, '/') = '\0';
+    } else {
+        exe_dir[0] = '.';
+        exe_dir[1] = '\0';
+    }
+
+    for (size_t d = 0; d < sizeof(dirs) / sizeof(dirs[0]); d++) {
+        for (size_t i = 0; i < sizeof(wordlist_names) / sizeof(wordlist_names[0]); i++) {
+            snprintf(path, size, "%s/%s", dirs[d], wordlist_names[i]);
+            if (access(path, R_OK) == 0) {
+                return 0;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Load the wordlist from path. When path is NULL the built-in table is used
+ * if the server was built with EMBED_WORDLIST=1, otherwise the search path.
+ */
+static int load_wordlist(const char *path)
+{
+    char found[PATH_MAX];
+
+    if (!path) {
+#ifdef WORDLIST_EMBEDDED
+        wordlist = wordlist_embedded;
+        printf("Using built-in wordlist\n");
+        return 0;
+#endif
+        if (find_wordlist(found, sizeof(found)) < 0) {
+            fprintf(stderr, "Error: cannot open EFF wordlist file\n");
             return -1;
         }
-        word_count++;
+        path = found;
     }
 
-    fclose(fp);
+    if (wordlist_load(path, &wordlist) < 0) {
+        fprintf(stderr, "Error: cannot load wordlist %s: %s\n", path, strerror(errno));
+        return -1;
+    }
 
-    if (word_count != 7776) {
-        fprintf(stderr, "Warning: loaded %d words, expected 7776\n", word_count);
+    if (wordlist.count != WORDLIST_SIZE) {
+        fprintf(stderr, "Warning: loaded %u words, expected %d\n", wordlist.count, WORDLIST_SIZE);
     }
 
+    printf("Loaded %s wordlist from %s\n", wordlist.map ? "mapped" : "parsed", path);
     return 0;
 }
 
-static void generate_passphrase(vfu_ctx_t *vfu_ctx, struct mock_accel_state *state)
+/*
+ * Build a passphrase of length words into out. Returns 0 on success, -1 on
+ * error. Only touches the shared read-only wordlist, so it may run on any
+ * thread without holding the device lock.
+ */
+static int generate_passphrase(vfu_ctx_t *vfu_ctx, uint32_t length, char separator,
+                               char *out, size_t out_size)
 {
     /* Validate word length */
-    if (state->passphrase_length < 4 || state->passphrase_length > 12) {
+    if (length < 4 || length > 12) {
         vfu_log(vfu_ctx, LOG_ERR, "Invalid passphrase length %u (must be 4-12)",
-                state->passphrase_length);
-        state->passphrase_status = 3;  /* Error */
-        return;
+                length);
+        return -1;
     }
 
     /* Check wordlist is loaded */
-    if (!state->wordlist[0]) {
+    if (wordlist.count == 0) {
         vfu_log(vfu_ctx, LOG_ERR, "Wordlist not loaded");
-        state->passphrase_status = 3;  /* Error */
-        return;
+        return -1;
     }
 
-    /* Set busy status */
-    state->passphrase_status = 1;
-
     /* Generate random word indices */
-    memset(state->passphrase_buffer, 0, sizeof(state->passphrase_buffer));
-    char *ptr = state->passphrase_buffer;
-    size_t remaining = sizeof(state->passphrase_buffer) - 1;
+    memset(out, 0, out_size);
+    char *ptr = out;
+    size_t remaining = out_size - 1;
 
-    for (uint32_t i = 0; i < state->passphrase_length; i++) {
-        /* Get cryptographically secure random index */
+    for (uint32_t i = 0; i < length; i++) {
+        /* Get cryptographically secure random index (0-7775) */
         uint16_t index;
-        ssize_t ret = getrandom(&index, sizeof(index), GRND_NONBLOCK);
-        if (ret != sizeof(index)) {
-            /* Fall back to /dev/urandom if getrandom fails */
-            int fd = open("/dev/urandom", O_RDONLY);
-            if (fd < 0 || read(fd, &index, sizeof(index)) != sizeof(index)) {
-                vfu_log(vfu_ctx, LOG_ERR, "Failed to get random data");
-                state->passphrase_status = 3;  /* Error */
-                if (fd >= 0) close(fd);
-                return;
-            }
-            close(fd);
+        if (entropy_word_index(&entropy, wordlist.count, &index) < 0) {
+            vfu_log(vfu_ctx, LOG_ERR, "Failed to get random data");
+            return -1;
         }
 
-        /* Map to wordlist range (0-7775) */
-        index = index % 7776;
-
-        /* Add word to buffer */
-        const char *word = state->wordlist[index];
-        size_t word_len = strlen(word);
+        /* Add word to buffer; lengths are precomputed in the index */
+        const char *word = wordlist.blob + wordlist.offsets[index];
+        size_t word_len = wordlist.lengths[index];
 
         if (i > 0) {
-            /* Add space separator */
+            /* Add separator */
             if (remaining < 1) {
                 vfu_log(vfu_ctx, LOG_ERR, "Passphrase buffer overflow");
-                state->passphrase_status = 3;  /* Error */
-                return;
+                return -1;
             }
-            *ptr++ = ' ';
+            *ptr++ = separator;
             remaining--;
         }
 
         if (remaining < word_len) {
             vfu_log(vfu_ctx, LOG_ERR, "Passphrase buffer overflow");
-            state->passphrase_status = 3;  /* Error */
-            return;
+            return -1;
         }
 
         memcpy(ptr, word, word_len);
@@ -261,232 +751,1590 @@ static void generate_passphrase(vfu_ctx_t *vfu_ctx, struct mock_accel_state *sta
     }
 
     *ptr = '\0';
-    state->passphrase_count = state->passphrase_length;
-    state->passphrase_status = 2;  /* Ready */
-
-    vfu_log(vfu_ctx, LOG_DEBUG, "Generated passphrase: %s", state->passphrase_buffer);
+    return 0;
 }
 
-static ssize_t bar0_access(vfu_ctx_t *vfu_ctx, char * const buf, size_t count,
-                            loff_t offset, const bool is_write)
+/*
+ * Value of the 32-bit BAR0 register at reg (4-byte aligned). Called with
+ * state->lock held.
+ */
+static uint32_t bar0_reg32(vfu_ctx_t *vfu_ctx, struct mock_accel_state *state, loff_t reg)
 {
-    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
-
-    if (is_write) {
-        /* Handle writable registers */
-        if (offset == REG_STATUS && count == 4) {
-            memcpy(&state->status, buf, 4);
-            return count;
-        }
-        if (offset == REG_PASSPHRASE_LENGTH && count == 4) {
-            uint32_t length;
-            memcpy(&length, buf, 4);
-            if (length >= 4 && length <= 12) {
-                state->passphrase_length = length;
-                return count;
-            }
-            vfu_log(vfu_ctx, LOG_ERR, "Invalid passphrase length %u (must be 4-12)", length);
-            errno = EINVAL;
-            return -1;
-        }
-        if (offset == REG_PASSPHRASE_CMD && count == 4) {
-            uint32_t cmd;
-            memcpy(&cmd, buf, 4);
-            if (cmd == 1) {
-                generate_passphrase(vfu_ctx, state);
-                return count;
-            }
-            return count;
-        }
-        vfu_log(vfu_ctx, LOG_ERR, "write to read-only register 0x%lx", offset);
-        errno = EINVAL;
-        return -1;
-    }
-
-    /* Read operations */
-    uint64_t value = 0;
-    size_t value_size = 0;
+    uint32_t value;
 
-    switch (offset) {
+    switch (reg) {
     case REG_DEVICE_ID:
-        value = DEVICE_ID_MAGIC;
-        value_size = 4;
-        break;
+        return DEVICE_ID_MAGIC;
     case REG_REVISION:
-        value = REVISION;
-        value_size = 4;
-        break;
+        return REVISION;
     case REG_UUID ... REG_UUID + 15:
-        /* Return individual UUID bytes */
-        if (count == 1) {
-            buf[0] = state->uuid_bytes[offset - REG_UUID];
-            return 1;
-        }
-        /* Multi-byte read of UUID */
-        for (size_t i = 0; i < count && (offset - REG_UUID + i) < 16; i++) {
-            buf[i] = state->uuid_bytes[offset - REG_UUID + i];
-        }
-        return count;
+        memcpy(&value, state->uuid_bytes + (reg - REG_UUID), sizeof(value));
+        return value;
     case REG_MEMORY_SIZE:
-        value = state->memory_size;
-        value_size = 8;
-        break;
+        return state->memory_size & 0xffffffff;
+    case REG_MEMORY_SIZE + 4:
+        return state->memory_size >> 32;
     case REG_CAPABILITIES:
-        value = state->capabilities;
-        value_size = 4;
-        break;
+        return state->capabilities;
     case REG_STATUS:
-        value = state->status;
-        value_size = 4;
-        break;
+        return state->status;
     case REG_FW_VERSION:
-        value = FW_VERSION;
-        value_size = 4;
-        break;
+        return FW_VERSION;
     case REG_PASSPHRASE_LENGTH:
-        value = state->passphrase_length;
-        value_size = 4;
-        break;
+        return state->passphrase_length;
     case REG_PASSPHRASE_STATUS:
-        value = state->passphrase_status;
-        value_size = 4;
-        break;
+        return state->passphrase_status;
     case REG_PASSPHRASE_COUNT:
-        value = state->passphrase_count;
-        value_size = 4;
-        break;
+        return state->passphrase_count;
+    case REG_PASSPHRASE_BYTES:
+        return state->passphrase_bytes;
+    case REG_PASSPHRASE_BATCH:
+        return state->passphrase_batch;
+    case REG_RING_BASE_LO:
+        return state->ring_base & 0xffffffff;
+    case REG_RING_BASE_HI:
+        return state->ring_base >> 32;
+    case REG_RING_SIZE:
+        return state->ring_size;
+    case REG_RING_HEAD:
+        return state->ring_head;
+    case REG_RING_TAIL:
+        return state->ring_tail;
+    case REG_RING_STATUS:
+        return state->ring_status;
     case REG_PASSPHRASE_BUFFER ... REG_PASSPHRASE_BUFFER + 255:
-        /* Read from passphrase buffer */
-        {
-            size_t buffer_offset = offset - REG_PASSPHRASE_BUFFER;
-            size_t copy_len = count;
-            if (buffer_offset + copy_len > sizeof(state->passphrase_buffer)) {
-                copy_len = sizeof(state->passphrase_buffer) - buffer_offset;
-            }
-            memcpy(buf, state->passphrase_buffer + buffer_offset, copy_len);
-            return copy_len;
-        }
+        memcpy(&value, state->passphrase_buffer + (reg - REG_PASSPHRASE_BUFFER),
+               sizeof(value));
+        return value;
     default:
-        vfu_log(vfu_ctx, LOG_DEBUG, "read from unknown register 0x%lx", offset);
-        memset(buf, 0, count);
-        return count;
+        vfu_log(vfu_ctx, LOG_DEBUG, "read from unknown register 0x%lx", reg);
+        return 0;
     }
-
-    /* Copy value to buffer */
-    if (count > value_size) {
-        memset(buf, 0, count);
-        count = value_size;
-    }
-    memcpy(buf, &value, count);
-    return count;
 }
 
-static int device_reset(vfu_ctx_t *vfu_ctx, vfu_reset_type_t type)
+/*
+ * Refresh the info page from the register file. Called with state->lock
+ * held whenever a mirrored register changes.
+ */
+static void info_page_update(struct mock_accel_state *state)
 {
-    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
-    (void)type;
+    /* Mirrored ranges, written in order; the buffer before its status */
+    static const struct { loff_t start, end; } ranges[] = {
+        { REG_PASSPHRASE_BUFFER, REG_PASSPHRASE_BUFFER + 256 },
+        { REG_DEVICE_ID, REG_FW_VERSION + 4 },
+        { REG_PASSPHRASE_CMD, REG_PASSPHRASE_STATUS },
+        { REG_PASSPHRASE_COUNT, REG_PASSPHRASE_BATCH + 4 },
+    };
+    uint32_t value;
 
-    vfu_log(vfu_ctx, LOG_INFO, "device reset");
-    state->status = STATUS_READY;
+    if (!state->info_page) {
+        return;
+    }
 
-    /* Reset passphrase state */
-    state->passphrase_status = 0;
-    state->passphrase_count = 0;
-    memset(state->passphrase_buffer, 0, sizeof(state->passphrase_buffer));
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        for (loff_t reg = ranges[i].start; reg < ranges[i].end; reg += 4) {
+            value = bar0_reg32(state->vfu_ctx, state, reg);
+            memcpy(state->info_page + reg, &value, sizeof(value));
+        }
+    }
 
-    return 0;
+    value = state->passphrase_status;
+    __atomic_store_n((uint32_t *)(state->info_page + REG_PASSPHRASE_STATUS), value,
+                     __ATOMIC_RELEASE);
 }
 
-static ssize_t config_space_access(vfu_ctx_t *vfu_ctx, char * const buf,
-                                    size_t count, loff_t offset,
-                                    const bool is_write)
+/*
+ * Signal a completion vector. Fails harmlessly while the guest has not
+ * enabled MSI-X, in which case it is expected to poll the status registers.
+ */
+static void raise_irq(struct mock_accel_state *state, uint32_t vector)
 {
-    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
-    vfu_pci_config_space_t *config_space = vfu_pci_get_config_space(vfu_ctx);
-
-    vfu_log(vfu_ctx, LOG_DEBUG, "Config space %s: offset=0x%lx count=%zu",
-            is_write ? "write" : "read", offset, count);
-
-    /* Handle reads and writes that span multiple regions */
-    if (!is_write) {
-        /* Read operation */
-        size_t bytes_copied = 0;
-
-        /* First, copy standard config space (0x00-0xFF) */
-        if (offset < 0x100) {
-            size_t std_bytes = (offset + count <= 0x100) ? count : (size_t)(0x100 - offset);
-            memcpy(buf, (char *)config_space + offset, std_bytes);
-            bytes_copied += std_bytes;
-        }
-
-        /* Then, copy extended config space (0x100-0xFFF) */
-        if (offset + count > 0x100) {
-            size_t ext_start = (offset >= 0x100) ? 0 : (0x100 - offset);
-            size_t ext_offset = (offset >= 0x100) ? (offset - 0x100) : 0;
-            size_t ext_bytes = count - ext_start;
-
-            /* Copy SR-IOV capability if in range */
-            if (ext_offset < state->sriov_cap_size) {
-                size_t cap_bytes = (ext_offset + ext_bytes <= state->sriov_cap_size) ?
-                                   ext_bytes : (state->sriov_cap_size - ext_offset);
-                memcpy(buf + ext_start, state->sriov_cap + ext_offset, cap_bytes);
-                vfu_log(vfu_ctx, LOG_DEBUG, "Copied %zu bytes of SR-IOV cap from offset %zu to buf[%zu]",
-                        cap_bytes, ext_offset, ext_start);
-                /* Dump first 4 bytes of SR-IOV cap for verification */
-                if (ext_offset == 0 && cap_bytes >= 4) {
-                    uint32_t header = 0;
-                    memcpy(&header, buf + ext_start, 4);
-                    vfu_log(vfu_ctx, LOG_DEBUG, "SR-IOV header in buffer: 0x%08x", header);
-                }
-                bytes_copied += cap_bytes;
-                ext_start += cap_bytes;
-                ext_offset += cap_bytes;
-                ext_bytes -= cap_bytes;
-            }
+    if (vfu_irq_trigger(state->vfu_ctx, vector) < 0 && errno != ENOENT) {
+        vfu_log(state->vfu_ctx, LOG_DEBUG, "MSI-X vector %u not triggered: %m", vector);
+    }
+}
 
-            /* Fill remaining extended config space with 0xFF */
-            if (ext_bytes > 0) {
-                memset(buf + ext_start, 0xff, ext_bytes);
-                bytes_copied += ext_bytes;
-            }
+/*
+ * Execute the passphrase command latched in state: one result into
+ * REG_PASSPHRASE_BUFFER, or job_batch results into the result window
+ */
+static void execute_passphrase_cmd(struct mock_accel_state *state)
+{
+    struct result_slot slots[RESULT_SLOTS];
+    uint32_t length, batch, n;
+    uint64_t seq, submitted;
+    int ret = 0;
+
+    pthread_mutex_lock(&state->lock);
+    length = state->job_length;
+    batch = state->job_batch;
+    seq = state->job_seq;
+    submitted = state->job_submitted_ns;
+    pthread_mutex_unlock(&state->lock);
+
+    /* Generate outside the lock; the window is only touched to publish */
+    n = batch ? batch : 1;
+    memset(slots, 0, n * sizeof(slots[0]));
+    for (uint32_t i = 0; i < n; i++) {
+        struct result_slot *slot = &slots[i];
+
+        if (generate_passphrase(state->vfu_ctx, length, ' ', slot->text,
+                                sizeof(slot->text)) == 0) {
+            slot->status = PASSPHRASE_READY;
+            slot->bytes = strlen(slot->text);
+            slot->words = length;
+        } else {
+            slot->status = PASSPHRASE_ERROR;
+            ret = -1;
         }
+    }
 
-        vfu_log(vfu_ctx, LOG_DEBUG, "Config space read completed: %zu bytes", bytes_copied);
-        return count;
-    } else {
-        /* Write operation */
-        if (offset < 0x100) {
-            size_t std_bytes = (offset + count <= 0x100) ? count : (size_t)(0x100 - offset);
-            memcpy((char *)config_space + offset, buf, std_bytes);
+    pthread_mutex_lock(&state->lock);
+    if (seq == state->job_seq) {
+        if (batch && state->results) {
+            memcpy(state->results, slots, batch * sizeof(slots[0]));
+            memset(state->results + batch, 0, (RESULT_SLOTS - batch) * sizeof(slots[0]));
         }
-        /* Ignore writes to extended config space */
-        return count;
+        if (ret == 0) {
+            memset(state->passphrase_buffer, 0, sizeof(state->passphrase_buffer));
+            memcpy(state->passphrase_buffer, slots[0].text, slots[0].bytes);
+            state->passphrase_count = length;
+            state->passphrase_bytes = slots[0].bytes;
+            state->passphrase_status = PASSPHRASE_READY;
+        } else {
+            state->passphrase_status = PASSPHRASE_ERROR;
+        }
+        info_page_update(state);
     }
+    pthread_mutex_unlock(&state->lock);
+
+    stats_record_latency(&state->stats, STATS_CMD_PASSPHRASE, stats_now_ns() - submitted);
+
+    if (ret == 0) {
+        vfu_log(state->vfu_ctx, LOG_DEBUG, "Generated %u passphrase(s), first: %s", n,
+                slots[0].text);
+    }
+
+    raise_irq(state, MSIX_VEC_PASSPHRASE);
 }
 
-static uint64_t parse_size(const char *str)
+static dma_sg_t *dma_sg_at(struct mock_accel_state *state, size_t index)
 {
-    char *end;
-    uint64_t value = strtoull(str, &end, 10);
+    return (dma_sg_t *)((char *)state->dma_sg + index * dma_sg_size());
+}
 
-    switch (*end) {
-    case 'G': case 'g': value *= 1024 * 1024 * 1024; break;
-    case 'M': case 'm': value *= 1024 * 1024; break;
-    case 'K': case 'k': value *= 1024; break;
+/*
+ * Map len bytes of guest memory at iova, which may span several DMA
+ * regions, into iov using the dma_sg slots starting at slot. Returns the
+ * number of iovecs or -1. Called with dma_lock held; release with
+ * vfu_sgl_put().
+ */
+static int dma_map(struct mock_accel_state *state, size_t slot, uint64_t iova,
+                   size_t len, int prot, struct iovec *iov)
+{
+    dma_sg_t *sg = dma_sg_at(state, slot);
+    int nr;
+
+    nr = vfu_addr_to_sgl(state->vfu_ctx, (vfu_dma_addr_t)(uintptr_t)iova, len,
+                         sg, DMA_MAX_SGS, prot);
+    if (nr < 0) {
+        return -1;
     }
-    return value;
+    if (vfu_sgl_get(state->vfu_ctx, sg, iov, nr, 0) < 0) {
+        return -1;
+    }
+    return nr;
 }
 
-static void usage(const char *prog)
+/*
+ * Copy len bytes from data into guest memory at iova. Called with
+ * dma_lock held.
+ */
+static int dma_write(struct mock_accel_state *state, uint64_t iova,
+                     const void *data, size_t len)
 {
-    fprintf(stderr, "Usage: %s [OPTIONS] <socket_path>\n", prog);
+    struct iovec iov[DMA_MAX_SGS];
+    const char *src = data;
+    int nr;
+
+    nr = dma_map(state, DMA_SG_DST, iova, len, PROT_WRITE, iov);
+    if (nr < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < nr; i++) {
+        memcpy(iov[i].iov_base, src, iov[i].iov_len);
+        src += iov[i].iov_len;
+    }
+
+    vfu_sgl_put(state->vfu_ctx, dma_sg_at(state, DMA_SG_DST), iov, nr);
+    return 0;
+}
+
+/*
+ * COPY, COMPARE and XOR: walk the destination and source scatter-gather
+ * lists together, operating directly on the mapped guest memory. Returns
+ * the bytes processed, which for COMPARE is the offset of the first
+ * difference. Called with dma_lock held.
+ */
+static uint64_t dma_copy_compare(const struct iovec *dst, int nr_dst,
+                                 const struct iovec *src, int nr_src, uint16_t opcode)
+{
+    size_t d_off = 0, s_off = 0;
+    uint64_t done = 0;
+    int d = 0, s = 0;
+
+    while (d < nr_dst && s < nr_src) {
+        char *dp = (char *)dst[d].iov_base + d_off;
+        const char *sp = (const char *)src[s].iov_base + s_off;
+        size_t n = dst[d].iov_len - d_off;
+
+        if (src[s].iov_len - s_off < n) {
+            n = src[s].iov_len - s_off;
+        }
+
+        if (opcode == DESC_OP_COPY) {
+            memmove(dp, sp, n);
+        } else if (opcode == DESC_OP_XOR) {
+            compute_xor(dp, sp, n);
+        } else if (memcmp(dp, sp, n) != 0) {
+            while (*dp == *sp) {
+                dp++;
+                sp++;
+                done++;
+            }
+            return done;
+        }
+        done += n;
+
+        d_off += n;
+        if (d_off == dst[d].iov_len) {
+            d++;
+            d_off = 0;
+        }
+        s_off += n;
+        if (s_off == src[s].iov_len) {
+            s++;
+            s_off = 0;
+        }
+    }
+    return done;
+}
+
+/*
+ * FILL: repeat pattern over the destination. Memory at offset i receives
+ * byte i % 8 of the little-endian pattern. Called with dma_lock held.
+ */
+static uint64_t dma_fill(const struct iovec *dst, int nr_dst, uint64_t pattern)
+{
+    char buf[64 + sizeof(pattern)];
+    uint64_t done = 0;
+
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (char)(pattern >> (8 * (i % sizeof(pattern))));
+    }
+
+    for (int d = 0; d < nr_dst; d++) {
+        char *dp = dst[d].iov_base;
+        size_t left = dst[d].iov_len;
+        size_t phase = done % sizeof(pattern);
+
+        while (left > 0) {
+            size_t n = left < 64 ? left : 64;
+
+            memcpy(dp, buf + phase, n);
+            dp += n;
+            left -= n;
+        }
+        done += dst[d].iov_len;
+    }
+    return done;
+}
+
+/*
+ * CRC32C and XXH64 over the source scatter-gather list, one fragment at
+ * a time. Called with dma_lock held.
+ */
+static uint64_t dma_checksum(const struct iovec *src, int nr_src, uint16_t opcode,
+                             uint64_t seed)
+{
+    struct xxh64_state xxh;
+    uint32_t crc = (uint32_t)seed;
+
+    xxh64_init(&xxh, seed);
+    for (int i = 0; i < nr_src; i++) {
+        if (opcode == DESC_OP_CRC32C) {
+            crc = compute_crc32c(crc, src[i].iov_base, src[i].iov_len);
+        } else {
+            xxh64_update(&xxh, src[i].iov_base, src[i].iov_len);
+        }
+    }
+    return opcode == DESC_OP_CRC32C ? crc : xxh64_digest(&xxh);
+}
+
+static uint32_t execute_checksum_desc(struct mock_accel_state *state,
+                                      const struct mock_accel_desc *desc,
+                                      uint32_t *result_len, uint64_t *result)
+{
+    struct iovec src[DMA_MAX_SGS];
+    int nr_src = 0;
+
+    if (desc->dst_len > 0) {
+        nr_src = dma_map(state, DMA_SG_SRC, desc->src_addr, desc->dst_len, PROT_READ, src);
+        if (nr_src < 0) {
+            vfu_log(state->vfu_ctx, LOG_ERR, "cannot map DMA source 0x%lx+%u: %m",
+                    desc->src_addr, desc->dst_len);
+            return DESC_STATUS_ERROR;
+        }
+    }
+
+    *result = dma_checksum(src, nr_src, desc->opcode, desc->pattern);
+    *result_len = desc->dst_len;
+    if (nr_src > 0) {
+        vfu_sgl_put(state->vfu_ctx, dma_sg_at(state, DMA_SG_SRC), src, nr_src);
+    }
+    return DESC_STATUS_DONE;
+}
+
+/*
+ * Execute a COPY, FILL, COMPARE or XOR descriptor. Returns the
+ * DESC_STATUS_* to report and the bytes processed in *result_len. Called
+ * with dma_lock held.
+ */
+static uint32_t execute_dma_desc(struct mock_accel_state *state,
+                                 const struct mock_accel_desc *desc,
+                                 uint32_t *result_len)
+{
+    struct iovec dst[DMA_MAX_SGS], src[DMA_MAX_SGS];
+    int dst_prot = desc->opcode == DESC_OP_COMPARE ? PROT_READ :
+                   desc->opcode == DESC_OP_XOR ? PROT_READ | PROT_WRITE : PROT_WRITE;
+    int nr_dst, nr_src = 0;
+
+    if (desc->dst_len == 0) {
+        *result_len = 0;
+        return DESC_STATUS_DONE;
+    }
+
+    nr_dst = dma_map(state, DMA_SG_DST, desc->dst_addr, desc->dst_len, dst_prot, dst);
+    if (nr_dst < 0) {
+        vfu_log(state->vfu_ctx, LOG_ERR, "cannot map DMA destination 0x%lx+%u: %m",
+                desc->dst_addr, desc->dst_len);
+        return DESC_STATUS_ERROR;
+    }
+    if (desc->opcode != DESC_OP_FILL) {
+        nr_src = dma_map(state, DMA_SG_SRC, desc->src_addr, desc->dst_len, PROT_READ, src);
+        if (nr_src < 0) {
+            vfu_log(state->vfu_ctx, LOG_ERR, "cannot map DMA source 0x%lx+%u: %m",
+                    desc->src_addr, desc->dst_len);
+            vfu_sgl_put(state->vfu_ctx, dma_sg_at(state, DMA_SG_DST), dst, nr_dst);
+            return DESC_STATUS_ERROR;
+        }
+    }
+
+    if (desc->opcode == DESC_OP_FILL) {
+        *result_len = (uint32_t)dma_fill(dst, nr_dst, desc->pattern);
+    } else {
+        *result_len = (uint32_t)dma_copy_compare(dst, nr_dst, src, nr_src, desc->opcode);
+        vfu_sgl_put(state->vfu_ctx, dma_sg_at(state, DMA_SG_SRC), src, nr_src);
+    }
+    vfu_sgl_put(state->vfu_ctx, dma_sg_at(state, DMA_SG_DST), dst, nr_dst);
+
+    return DESC_STATUS_DONE;
+}
+
+/*
+ * Execute one descriptor. Returns the DESC_STATUS_* to report; on success
+ * *result_len holds the number of bytes written (excluding NUL) and
+ * *value the checksum, if any.
+ */
+static uint32_t execute_desc(struct mock_accel_state *state,
+                             const struct mock_accel_desc *desc,
+                             uint32_t *result_len, uint64_t *value)
+{
+    char result[sizeof(state->passphrase_buffer)];
+    char separator = desc->separator ? (char)desc->separator : ' ';
+    size_t len;
+
+    switch (desc->opcode) {
+    case DESC_OP_PASSPHRASE:
+        if (generate_passphrase(state->vfu_ctx, desc->word_count, separator,
+                                result, sizeof(result)) < 0) {
+            return DESC_STATUS_ERROR;
+        }
+        len = strlen(result);
+        if (len + 1 > desc->dst_len) {
+            vfu_log(state->vfu_ctx, LOG_ERR, "descriptor buffer too small (%u < %zu)",
+                    desc->dst_len, len + 1);
+            return DESC_STATUS_ERROR;
+        }
+        if (dma_write(state, desc->dst_addr, result, len + 1) < 0) {
+            vfu_log(state->vfu_ctx, LOG_ERR, "DMA write to 0x%lx failed: %m",
+                    desc->dst_addr);
+            return DESC_STATUS_ERROR;
+        }
+        *result_len = len;
+        return DESC_STATUS_DONE;
+    case DESC_OP_COPY:
+    case DESC_OP_FILL:
+    case DESC_OP_COMPARE:
+    case DESC_OP_XOR:
+        return execute_dma_desc(state, desc, result_len);
+    case DESC_OP_CRC32C:
+    case DESC_OP_XXH64:
+        return execute_checksum_desc(state, desc, result_len, value);
+    default:
+        vfu_log(state->vfu_ctx, LOG_ERR, "unknown descriptor opcode 0x%x", desc->opcode);
+        return DESC_STATUS_ERROR;
+    }
+}
+
+/*
+ * Process every posted descriptor between tail and head. Descriptors are
+ * accessed in place through the mapped guest memory and completed by
+ * writing result_len and then status.
+ */
+static void process_ring(struct mock_accel_state *state)
+{
+    dma_sg_t *sg = dma_sg_at(state, 0);
+    bool completed = false;
+
+    for (;;) {
+        struct mock_accel_desc *desc;
+        struct mock_accel_desc copy;
+        struct iovec iov;
+        uint64_t base, seq;
+        uint32_t size, tail, status, result_len = 0;
+        uint64_t result = 0;
+
+        pthread_mutex_lock(&state->lock);
+        base = state->ring_base;
+        size = state->ring_size;
+        tail = state->ring_tail;
+        seq = state->job_seq;
+        if (state->dma_paused) {
+            /* Resubmitted by dma_resume() */
+            pthread_mutex_unlock(&state->lock);
+            break;
+        }
+        if (size == 0 || tail == state->ring_head || state->ring_status == PASSPHRASE_ERROR) {
+            if (state->ring_status != PASSPHRASE_ERROR) {
+                state->ring_status = PASSPHRASE_IDLE;
+            }
+            pthread_mutex_unlock(&state->lock);
+            break;
+        }
+        state->ring_status = PASSPHRASE_BUSY;
+        pthread_mutex_unlock(&state->lock);
+
+        uint64_t iova = base + (uint64_t)(tail & (size - 1)) * sizeof(*desc);
+
+        pthread_mutex_lock(&state->dma_lock);
+        if (vfu_addr_to_sgl(state->vfu_ctx, (vfu_dma_addr_t)(uintptr_t)iova, sizeof(*desc),
+                            sg, 1, PROT_READ | PROT_WRITE) != 1 ||
+            vfu_sgl_get(state->vfu_ctx, sg, &iov, 1, 0) < 0) {
+            pthread_mutex_unlock(&state->dma_lock);
+            vfu_log(state->vfu_ctx, LOG_ERR, "cannot map descriptor at 0x%lx", iova);
+            pthread_mutex_lock(&state->lock);
+            state->ring_status = PASSPHRASE_ERROR;
+            pthread_mutex_unlock(&state->lock);
+            completed = true;
+            break;
+        }
+
+        desc = iov.iov_base;
+        memcpy(&copy, desc, sizeof(copy));
+        uint64_t start = stats_now_ns();
+        status = execute_desc(state, &copy, &result_len, &result);
+        stats_record_latency(&state->stats, STATS_CMD_DESCRIPTOR, stats_now_ns() - start);
+
+        desc->result_len = result_len;
+        desc->result = result;
+        __atomic_store_n(&desc->status, status, __ATOMIC_RELEASE);
+        vfu_sgl_put(state->vfu_ctx, sg, &iov, 1);
+        pthread_mutex_unlock(&state->dma_lock);
+
+        pthread_mutex_lock(&state->lock);
+        if (seq == state->job_seq) {
+            state->ring_tail = tail + 1;
+        }
+        pthread_mutex_unlock(&state->lock);
+        completed = true;
+    }
+
+    /* One interrupt per drained batch */
+    if (completed) {
+        raise_irq(state, MSIX_VEC_RING);
+    }
+}
+
+/*
+ * Run all pending work for a device. Runs on the device's worker or,
+ * without a worker pool, inline on the event loop.
+ */
+static void run_jobs(struct mock_accel_state *state)
+{
+    uint32_t jobs;
+
+    pthread_mutex_lock(&state->lock);
+    jobs = state->jobs;
+    state->jobs = 0;
+    pthread_mutex_unlock(&state->lock);
+
+    if (jobs & JOB_PASSPHRASE) {
+        execute_passphrase_cmd(state);
+    }
+    if (jobs & JOB_RING) {
+        process_ring(state);
+    }
+
+    pthread_mutex_lock(&state->lock);
+    if (--state->job_runs == 0) {
+        pthread_cond_broadcast(&state->idle);
+    }
+    pthread_mutex_unlock(&state->lock);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+
+    for (;;) {
+        struct mock_accel_state *state;
+
+        pthread_mutex_lock(&w->lock);
+        while (!w->head && !w->stop) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (!w->head) {
+            /* Stopping; queued runs are drained first so job_runs settles */
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        state = w->head;
+        w->head = state->job_next;
+        if (!w->head) {
+            w->tail = NULL;
+        }
+        state->job_next = NULL;
+        pthread_mutex_unlock(&w->lock);
+
+        run_jobs(state);
+    }
+
+    return NULL;
+}
+
+static void worker_enqueue(struct worker *w, struct mock_accel_state *state)
+{
+    pthread_mutex_lock(&w->lock);
+    state->job_next = NULL;
+    if (w->tail) {
+        w->tail->job_next = state;
+    } else {
+        w->head = state;
+    }
+    w->tail = state;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/*
+ * Mark work pending for a device and hand it to the device's worker. A
+ * device sits on its worker queue at most once; work posted while it is
+ * queued is picked up by the same run.
+ */
+static void submit_job(struct mock_accel_state *state, uint32_t job)
+{
+    bool queue;
+
+    pthread_mutex_lock(&state->lock);
+    queue = state->jobs == 0;
+    state->jobs |= job;
+    if (queue) {
+        state->job_runs++;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (!queue) {
+        return;
+    }
+    if (state->worker) {
+        worker_enqueue(state->worker, state);
+    } else {
+        run_jobs(state);
+    }
+}
+
+/*
+ * Wait for queued and running commands. The caller makes sure no more are
+ * posted: the guest is stopped or the client is gone.
+ */
+static void device_quiesce(struct mock_accel_state *state)
+{
+    pthread_mutex_lock(&state->lock);
+    while (state->job_runs) {
+        pthread_cond_wait(&state->idle, &state->lock);
+    }
+    pthread_mutex_unlock(&state->lock);
+}
+
+/*
+ * Latch a passphrase command. Commands issued while one is still in
+ * flight are ignored, like a busy engine.
+ */
+static void submit_passphrase_cmd(vfu_ctx_t *vfu_ctx, struct mock_accel_state *state)
+{
+    pthread_mutex_lock(&state->lock);
+    if (state->passphrase_status == PASSPHRASE_BUSY) {
+        pthread_mutex_unlock(&state->lock);
+        vfu_log(vfu_ctx, LOG_DEBUG, "Passphrase engine busy, command ignored");
+        return;
+    }
+    state->passphrase_status = PASSPHRASE_BUSY;
+    state->job_length = state->passphrase_length;
+    state->job_batch = state->passphrase_batch;
+    state->job_submitted_ns = stats_now_ns();
+    info_page_update(state);
+    pthread_mutex_unlock(&state->lock);
+
+    submit_job(state, JOB_PASSPHRASE);
+}
+
+/*
+ * Handle a write to one of the descriptor ring registers
+ */
+static int ring_write(vfu_ctx_t *vfu_ctx, struct mock_accel_state *state,
+                      loff_t offset, uint32_t value)
+{
+    bool doorbell = false;
+
+    pthread_mutex_lock(&state->lock);
+    switch (offset) {
+    case REG_RING_BASE_LO:
+    case REG_RING_BASE_HI:
+        if (offset == REG_RING_BASE_LO) {
+            state->ring_base = (state->ring_base & ~0xffffffffULL) | value;
+        } else {
+            state->ring_base = (state->ring_base & 0xffffffffULL) | ((uint64_t)value << 32);
+        }
+        state->ring_head = state->ring_tail = 0;
+        state->ring_status = PASSPHRASE_IDLE;
+        break;
+    case REG_RING_SIZE:
+        if (value > RING_MAX_SIZE || (value & (value - 1)) != 0) {
+            pthread_mutex_unlock(&state->lock);
+            vfu_log(vfu_ctx, LOG_ERR, "Invalid ring size %u (power of 2, max %d)",
+                    value, RING_MAX_SIZE);
+            errno = EINVAL;
+            return -1;
+        }
+        state->ring_size = value;
+        state->ring_head = state->ring_tail = 0;
+        state->ring_status = PASSPHRASE_IDLE;
+        break;
+    case REG_RING_HEAD:
+        if (state->ring_size == 0 || (state->ring_base & (sizeof(struct mock_accel_desc) - 1))) {
+            pthread_mutex_unlock(&state->lock);
+            vfu_log(vfu_ctx, LOG_ERR, "doorbell on unconfigured ring");
+            errno = EINVAL;
+            return -1;
+        }
+        if (value - state->ring_tail > state->ring_size) {
+            pthread_mutex_unlock(&state->lock);
+            vfu_log(vfu_ctx, LOG_ERR, "ring head %u overruns tail %u", value, state->ring_tail);
+            errno = EINVAL;
+            return -1;
+        }
+        state->ring_head = value;
+        doorbell = true;
+        break;
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (doorbell) {
+        submit_job(state, JOB_RING);
+    }
+    return 0;
+}
+
+/*
+ * libvfio-user quiesces the device before it changes the DMA map, resets
+ * the device or changes its migration state: a worker must not translate
+ * an IOVA or touch a mapping while that happens. The ring stops at the
+ * next descriptor boundary and device_quiesce() waits for the run to
+ * finish, so the device is quiesced when this returns. It stays so until
+ * the operation completes; dma_resume() runs once vfu_run_ctx() is done
+ * with the message.
+ */
+static int device_quiesce_cb(vfu_ctx_t *vfu_ctx)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+
+    pthread_mutex_lock(&state->lock);
+    state->dma_paused = true;
+    pthread_mutex_unlock(&state->lock);
+
+    device_quiesce(state);
+    return 0;
+}
+
+/*
+ * Pick up descriptors posted or left over while quiesced. A device
+ * stopped for migration stays paused: pending descriptors travel in the
+ * device state, or run when the source is set back to RUNNING. A device
+ * loaded from a migration stream also restarts a passphrase command the
+ * source had in flight; once quiesced, only such a command is still busy.
+ */
+static void dma_resume(struct mock_accel_state *state)
+{
+    bool passphrase, ring;
+
+    pthread_mutex_lock(&state->lock);
+    if (!state->dma_paused || (state->migr.state != VFU_MIGR_STATE_RUNNING &&
+                               state->migr.state != VFU_MIGR_STATE_PRE_COPY)) {
+        pthread_mutex_unlock(&state->lock);
+        return;
+    }
+    state->dma_paused = false;
+    passphrase = state->passphrase_status == PASSPHRASE_BUSY;
+    if (passphrase) {
+        state->job_length = state->passphrase_length;
+        state->job_batch = state->passphrase_batch;
+        state->job_submitted_ns = stats_now_ns();
+    }
+    ring = state->ring_size && state->ring_head != state->ring_tail &&
+           state->ring_status != PASSPHRASE_ERROR;
+    pthread_mutex_unlock(&state->lock);
+
+    if (passphrase) {
+        submit_job(state, JOB_PASSPHRASE);
+    }
+    if (ring) {
+        submit_job(state, JOB_RING);
+    }
+}
+
+/* DMA region callbacks; the device is quiesced, see device_quiesce_cb() */
+static void dma_register(vfu_ctx_t *vfu_ctx, vfu_dma_info_t *info)
+{
+    vfu_log(vfu_ctx, LOG_DEBUG, "DMA region added: iova=%p len=%#zx",
+            info->iova.iov_base, info->iova.iov_len);
+}
+
+static void dma_unregister(vfu_ctx_t *vfu_ctx, vfu_dma_info_t *info)
+{
+    vfu_log(vfu_ctx, LOG_DEBUG, "DMA region removed: iova=%p len=%#zx",
+            info->iova.iov_base, info->iova.iov_len);
+}
+
+/*
+ * Serve a BAR0 read of any width and alignment, e.g. a single 8-byte read
+ * of REG_MEMORY_SIZE or a memcpy_fromio() of the whole passphrase buffer,
+ * by assembling it from the 32-bit registers it covers. Called with
+ * state->lock held.
+ */
+static ssize_t bar0_read(vfu_ctx_t *vfu_ctx, struct mock_accel_state *state,
+                         char * const buf, size_t count, loff_t offset)
+{
+    size_t done = 0;
+
+    while (done < count) {
+        loff_t pos = offset + done;
+        loff_t reg = pos & ~(loff_t)3;
+        size_t skip = pos - reg;
+        size_t n = count - done < 4 - skip ? count - done : 4 - skip;
+        uint32_t value = bar0_reg32(vfu_ctx, state, reg);
+
+        memcpy(buf + done, (char *)&value + skip, n);
+        done += n;
+    }
+
+    return count;
+}
+
+/* Map a trapped BAR0 offset to its slot in struct device_stats */
+static unsigned int stat_reg(loff_t offset)
+{
+    if (offset >= RESULT_WINDOW_OFFSET) {
+        return STAT_RESULT_WINDOW;
+    }
+    if (offset >= INFO_PAGE_OFFSET) {
+        return STAT_INFO_PAGE;
+    }
+    if (offset >= REG_PASSPHRASE_BUFFER && offset < REG_PASSPHRASE_BUFFER + 256) {
+        return STAT_PASSPHRASE_BUFFER;
+    }
+
+    switch (offset & ~(loff_t)3) {
+    case REG_DEVICE_ID:          return STAT_DEVICE_ID;
+    case REG_REVISION:           return STAT_REVISION;
+    case REG_UUID:
+    case REG_UUID + 4:
+    case REG_UUID + 8:
+    case REG_UUID + 12:          return STAT_UUID;
+    case REG_MEMORY_SIZE:
+    case REG_MEMORY_SIZE + 4:    return STAT_MEMORY_SIZE;
+    case REG_CAPABILITIES:       return STAT_CAPABILITIES;
+    case REG_STATUS:             return STAT_STATUS;
+    case REG_FW_VERSION:         return STAT_FW_VERSION;
+    case REG_PASSPHRASE_CMD:     return STAT_PASSPHRASE_CMD;
+    case REG_PASSPHRASE_LENGTH:  return STAT_PASSPHRASE_LENGTH;
+    case REG_PASSPHRASE_STATUS:  return STAT_PASSPHRASE_STATUS;
+    case REG_PASSPHRASE_COUNT:   return STAT_PASSPHRASE_COUNT;
+    case REG_PASSPHRASE_BYTES:   return STAT_PASSPHRASE_BYTES;
+    case REG_PASSPHRASE_BATCH:   return STAT_PASSPHRASE_BATCH;
+    case REG_RING_BASE_LO:
+    case REG_RING_BASE_HI:       return STAT_RING_BASE;
+    case REG_RING_SIZE:          return STAT_RING_SIZE;
+    case REG_RING_HEAD:          return STAT_RING_HEAD;
+    case REG_RING_TAIL:          return STAT_RING_TAIL;
+    case REG_RING_STATUS:        return STAT_RING_STATUS;
+    default:                     return STAT_OTHER;
+    }
+}
+
+static ssize_t bar0_access(vfu_ctx_t *vfu_ctx, char * const buf, size_t count,
+                            loff_t offset, const bool is_write)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+
+    stats_count_access(&state->stats, stat_reg(offset), is_write, count);
+
+    /* Info page and result window accesses, when the client did not map them */
+    if (offset >= MAPPED_OFFSET) {
+        if (is_write) {
+            return count;
+        }
+        if (offset + count > MAPPED_OFFSET + MAPPED_SIZE || !state->info_page) {
+            memset(buf, 0, count);
+            return count;
+        }
+        pthread_mutex_lock(&state->lock);
+        memcpy(buf, state->info_page + (offset - MAPPED_OFFSET), count);
+        pthread_mutex_unlock(&state->lock);
+        return count;
+    }
+
+    if (is_write) {
+        /* Handle writable registers */
+        if (offset == REG_STATUS && count == 4) {
+            pthread_mutex_lock(&state->lock);
+            memcpy(&state->status, buf, 4);
+            info_page_update(state);
+            pthread_mutex_unlock(&state->lock);
+            return count;
+        }
+        if (offset == REG_PASSPHRASE_LENGTH && count == 4) {
+            uint32_t length;
+            memcpy(&length, buf, 4);
+            if (length >= 4 && length <= 12) {
+                pthread_mutex_lock(&state->lock);
+                state->passphrase_length = length;
+                info_page_update(state);
+                pthread_mutex_unlock(&state->lock);
+                return count;
+            }
+            vfu_log(vfu_ctx, LOG_ERR, "Invalid passphrase length %u (must be 4-12)", length);
+            errno = EINVAL;
+            return -1;
+        }
+        if (offset == REG_PASSPHRASE_BATCH && count == 4) {
+            uint32_t batch;
+            memcpy(&batch, buf, 4);
+            if (batch <= RESULT_SLOTS) {
+                pthread_mutex_lock(&state->lock);
+                state->passphrase_batch = batch;
+                info_page_update(state);
+                pthread_mutex_unlock(&state->lock);
+                return count;
+            }
+            vfu_log(vfu_ctx, LOG_ERR, "Invalid passphrase batch %u (max %d)", batch, RESULT_SLOTS);
+            errno = EINVAL;
+            return -1;
+        }
+        if (offset == REG_PASSPHRASE_CMD && count == 4) {
+            uint32_t cmd;
+            memcpy(&cmd, buf, 4);
+            if (cmd == 1) {
+                submit_passphrase_cmd(vfu_ctx, state);
+                return count;
+            }
+            return count;
+        }
+        if ((offset == REG_RING_BASE_LO || offset == REG_RING_BASE_HI ||
+             offset == REG_RING_SIZE || offset == REG_RING_HEAD) && count == 4) {
+            uint32_t value;
+            memcpy(&value, buf, 4);
+            if (ring_write(vfu_ctx, state, offset, value) < 0) {
+                return -1;
+            }
+            return count;
+        }
+        vfu_log(vfu_ctx, LOG_ERR, "write to read-only register 0x%lx", offset);
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Read operations */
+    ssize_t ret;
+
+    pthread_mutex_lock(&state->lock);
+    ret = bar0_read(vfu_ctx, state, buf, count, offset);
+    pthread_mutex_unlock(&state->lock);
+    return ret;
+}
+
+static void config_put16(uint8_t *config, size_t offset, uint16_t value)
+{
+    config[offset] = value & 0xff;
+    config[offset + 1] = value >> 8;
+}
+
+static uint16_t config_get16(const uint8_t *config, size_t offset)
+{
+    return config[offset] | (uint16_t)config[offset + 1] << 8;
+}
+
+static int device_reset(vfu_ctx_t *vfu_ctx, vfu_reset_type_t type)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+    (void)type;
+
+    vfu_log(vfu_ctx, LOG_INFO, "device reset");
+
+    /* Reset passphrase state; results of in-flight commands are dropped */
+    pthread_mutex_lock(&state->lock);
+    state->status = STATUS_READY;
+    state->passphrase_status = PASSPHRASE_IDLE;
+    state->passphrase_count = 0;
+    state->passphrase_bytes = 0;
+    state->passphrase_batch = 0;
+    state->job_seq++;
+    memset(state->passphrase_buffer, 0, sizeof(state->passphrase_buffer));
+    if (state->results) {
+        memset(state->results, 0, RESULT_SLOTS * sizeof(state->results[0]));
+    }
+
+    /* Disable the descriptor ring */
+    state->ring_base = 0;
+    state->ring_size = 0;
+    state->ring_head = state->ring_tail = 0;
+    state->ring_status = PASSPHRASE_IDLE;
+    info_page_update(state);
+    pthread_mutex_unlock(&state->lock);
+
+    /* Reset disables the VFs */
+    if (!state->is_vf && state->sriov_cap_size) {
+        config_put16(state->config, PCI_CFG_SPACE_SIZE + PCI_SRIOV_CTRL, 0);
+        config_put16(state->config, PCI_CFG_SPACE_SIZE + PCI_SRIOV_NUM_VF, 0);
+    }
+
+    return 0;
+}
+
+/*
+ * Build the PF config space image: the standard header as set up by
+ * libvfio-user, the SR-IOV capability at 0x100 and all-ones for the rest
+ * of extended space. Call after vfu_realize_ctx(), which fills in the BARs.
+ */
+static void config_setup(struct mock_accel_state *state)
+{
+    vfu_pci_config_space_t *config_space = vfu_pci_get_config_space(state->vfu_ctx);
+    size_t sriov = PCI_CFG_SPACE_SIZE;
+    uint8_t *wmask = state->config_wmask;
+
+    memcpy(state->config, config_space, PCI_CFG_SPACE_SIZE);
+    memset(state->config + PCI_CFG_SPACE_SIZE, 0xff,
+           PCI_CFG_SPACE_EXP_SIZE - PCI_CFG_SPACE_SIZE);
+    memcpy(state->config + sriov, state->sriov_cap, state->sriov_cap_size);
+
+    /*
+     * Standard header: everything but the identity, status, header type
+     * and pointer fields, as before; capability bodies stay writable.
+     */
+    memset(wmask, 0, PCI_CFG_SPACE_EXP_SIZE);
+    config_put16(wmask, PCI_COMMAND, 0xffff);
+    wmask[PCI_CACHE_LINE_SIZE] = 0xff;
+    wmask[PCI_LATENCY_TIMER] = 0xff;
+    memset(wmask + PCI_BASE_ADDRESS_0, 0xff, PCI_CARDBUS_CIS - PCI_BASE_ADDRESS_0);
+    memset(wmask + PCI_ROM_ADDRESS, 0xff, 4);
+    wmask[PCI_INTERRUPT_LINE] = 0xff;
+    memset(wmask + PCI_STD_HEADER_SIZEOF, 0xff, PCI_CFG_SPACE_SIZE - PCI_STD_HEADER_SIZEOF);
+
+    /* SR-IOV: VF Enable, VF Migration Enable, VF MSE, ARI; NumVFs; page size */
+    if (state->sriov_cap_size) {
+        config_put16(wmask, sriov + PCI_SRIOV_CTRL,
+                     PCI_SRIOV_CTRL_VFE | PCI_SRIOV_CTRL_VFM |
+                     PCI_SRIOV_CTRL_MSE | PCI_SRIOV_CTRL_ARI);
+        config_put16(wmask, sriov + PCI_SRIOV_NUM_VF, 0xffff);
+        memset(wmask + sriov + PCI_SRIOV_SYS_PGSIZE, 0xff, 4);
+    }
+
+    memcpy(state->config_default, state->config, PCI_CFG_SPACE_EXP_SIZE);
+}
+
+/*
+ * Give effect to a write to the SR-IOV capability. old is the image
+ * before the write. NumVFs is fixed while VFs are enabled and cannot
+ * exceed TotalVFs; the System Page Size must be one supported size.
+ */
+static void sriov_write(struct mock_accel_state *state, const uint8_t *old)
+{
+    uint8_t *cap = state->config + PCI_CFG_SPACE_SIZE;
+    uint16_t ctrl = config_get16(cap, PCI_SRIOV_CTRL);
+    uint16_t old_ctrl = config_get16(old, PCI_SRIOV_CTRL);
+    uint16_t num_vfs = config_get16(cap, PCI_SRIOV_NUM_VF);
+    uint32_t pgsize, supported;
+
+    if ((old_ctrl & PCI_SRIOV_CTRL_VFE) || num_vfs > state->total_vfs) {
+        memcpy(cap + PCI_SRIOV_NUM_VF, old + PCI_SRIOV_NUM_VF, 2);
+        num_vfs = config_get16(cap, PCI_SRIOV_NUM_VF);
+    }
+
+    memcpy(&pgsize, cap + PCI_SRIOV_SYS_PGSIZE, 4);
+    memcpy(&supported, cap + PCI_SRIOV_SUP_PGSIZE, 4);
+    if ((pgsize & (pgsize - 1)) || !(pgsize & supported)) {
+        memcpy(cap + PCI_SRIOV_SYS_PGSIZE, old + PCI_SRIOV_SYS_PGSIZE, 4);
+    }
+
+    if ((ctrl ^ old_ctrl) & PCI_SRIOV_CTRL_VFE) {
+        vfu_log(state->vfu_ctx, LOG_INFO, "SR-IOV: guest %s %u VFs",
+                ctrl & PCI_SRIOV_CTRL_VFE ? "enabled" : "disabled", num_vfs);
+    }
+}
+
+/*
+ * PF config space, 4 KiB with the SR-IOV capability. Reads come straight
+ * from the image; writes are merged through the write mask.
+ */
+static ssize_t config_space_access(vfu_ctx_t *vfu_ctx, char * const buf,
+                                    size_t count, loff_t offset,
+                                    const bool is_write)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+    uint8_t old[PCI_EXT_CAP_SRIOV_SIZEOF];
+    size_t sriov = PCI_CFG_SPACE_SIZE;
+
+    stats_count_access(&state->stats, STAT_CONFIG, is_write, count);
+
+    if (offset < 0 || (size_t)offset + count > PCI_CFG_SPACE_EXP_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!is_write) {
+        memcpy(buf, state->config + offset, count);
+        return count;
+    }
+
+    memcpy(old, state->config + sriov, sizeof(old));
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *byte = &state->config[offset + i];
+        uint8_t mask = state->config_wmask[offset + i];
+
+        *byte = (*byte & ~mask) | ((uint8_t)buf[i] & mask);
+    }
+
+    /* Keep libvfio-user's copy of the standard header in step */
+    if (offset < PCI_CFG_SPACE_SIZE) {
+        size_t n = (size_t)offset + count <= PCI_CFG_SPACE_SIZE ?
+                   count : (size_t)(PCI_CFG_SPACE_SIZE - offset);
+
+        memcpy((char *)vfu_pci_get_config_space(vfu_ctx) + offset,
+               state->config + offset, n);
+    }
+
+    if (state->sriov_cap_size && (size_t)offset < sriov + state->sriov_cap_size &&
+        (size_t)offset + count > sriov) {
+        sriov_write(state, old);
+    }
+    return count;
+}
+
+/*
+ * BAR2 accesses the client did not map, e.g. from a client without mmap
+ * support. The server keeps its own shared mapping of the memfd because
+ * hugetlbfs files cannot be written with pwrite().
+ */
+static ssize_t memory_bar_access(vfu_ctx_t *vfu_ctx, char * const buf, size_t count,
+                                 loff_t offset, const bool is_write)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+
+    stats_count_access(&state->stats, STAT_BAR2, is_write, count);
+
+    if (offset < 0 || (uint64_t)offset + count > state->mem_bar_size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (is_write) {
+        memcpy(state->mem + offset, buf, count);
+    } else {
+        memcpy(buf, state->mem + offset, count);
+    }
+    return count;
+}
+
+/*
+ * Live migration
+ *
+ * Pre-copy sends BAR2 in passes while the guest keeps running; each pass
+ * sends the pages whose contents changed since they were last sent.
+ * Guest writes to BAR2 go straight to the shared memfd and cannot be
+ * trapped, so changes are found by hashing: mincore() skips pages nobody
+ * has touched (it reports page cache residency for the whole memfd, not
+ * just this process's mappings) and never-sent zero pages are skipped
+ * too. Stop-and-copy runs one last pass and appends the device state, so
+ * downtime only covers what the guest dirtied during the last pre-copy
+ * pass plus ~5 KiB.
+ *
+ * Guest memory written by the DMA engine is marked dirty by libvfio-user
+ * when the SG is put, and the device is quiesced before it stops.
+ */
+static size_t migr_min(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+static uint64_t migr_hash(const void *buf, size_t len)
+{
+    struct xxh64_state st;
+    uint64_t hash;
+
+    xxh64_init(&st, 0);
+    xxh64_update(&st, buf, len);
+    hash = xxh64_digest(&st);
+    return hash ? hash : 1;  /* 0 means never sent */
+}
+
+static void migr_end(struct mock_accel_state *state)
+{
+    struct migration *m = &state->migr;
+
+    free(m->sent);
+    free(m->resident);
+    free(m->page);
+    m->sent = NULL;
+    m->resident = NULL;
+    m->page = NULL;
+    m->nr_pages = 0;
+    m->pass_active = false;
+    m->device_done = false;
+    m->rec.len = 0;
+    m->rec_done = 0;
+}
+
+/* Prepare to send: nothing has been sent yet */
+static int migr_begin(struct mock_accel_state *state)
+{
+    struct migration *m = &state->migr;
+
+    migr_end(state);
+    m->page_size = sysconf(_SC_PAGESIZE);
+    m->nr_pages = state->mem ? state->mem_bar_size / m->page_size : 0;
+    m->sent = calloc(m->nr_pages + 1, sizeof(m->sent[0]));
+    m->resident = malloc(m->nr_pages + 1);
+    m->page = calloc(1, m->page_size);
+    if (!m->sent || !m->resident || !m->page) {
+        migr_end(state);
+        errno = ENOMEM;
+        return -1;
+    }
+    m->zero_hash = migr_hash(m->page, m->page_size);
+
+    /* No record in progress */
+    m->rec_done = sizeof(m->rec);
+    return 0;
+}
+
+static void migr_start_pass(struct mock_accel_state *state)
+{
+    struct migration *m = &state->migr;
+
+    if (m->nr_pages && mincore(state->mem, state->mem_bar_size, m->resident) < 0) {
+        memset(m->resident, 1, m->nr_pages);
+    }
+    m->next_page = 0;
+    m->pass_pages = 0;
+    m->pass_active = true;
+}
+
+static void migr_save_device(struct mock_accel_state *state)
+{
+    struct migr_device_state *d = &state->migr.dev;
+
+    memset(d, 0, sizeof(*d));
+    d->magic = MIGR_MAGIC;
+    d->version = MIGR_VERSION;
+    d->size = sizeof(*d);
+    d->flags = state->is_vf ? MIGR_DEV_VF : 0;
+    memcpy(d->uuid, state->uuid_bytes, sizeof(d->uuid));
+    d->memory_size = state->memory_size;
+    d->mem_bar_size = state->mem_bar_size;
+
+    pthread_mutex_lock(&state->lock);
+    d->status = state->status;
+    d->passphrase_length = state->passphrase_length;
+    d->passphrase_status = state->passphrase_status;
+    d->passphrase_count = state->passphrase_count;
+    d->passphrase_bytes = state->passphrase_bytes;
+    d->passphrase_batch = state->passphrase_batch;
+    d->ring_base = state->ring_base;
+    d->ring_size = state->ring_size;
+    d->ring_head = state->ring_head;
+    d->ring_tail = state->ring_tail;
+    d->ring_status = state->ring_status;
+    memcpy(d->passphrase_buffer, state->passphrase_buffer, sizeof(d->passphrase_buffer));
+    if (state->results) {
+        memcpy(d->results, state->results, sizeof(d->results));
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (!state->is_vf) {
+        memcpy(d->config, state->config, sizeof(d->config));
+        memcpy(d->sriov_cap, state->config + PCI_CFG_SPACE_SIZE, sizeof(d->sriov_cap));
+    }
+}
+
+/*
+ * Pick the next record to send. Returns false once the current pass is
+ * complete: in pre-copy the next read starts a new pass, in stop-and-copy
+ * the device state follows the last pass and ends the stream.
+ */
+static bool migr_next_record(struct mock_accel_state *state)
+{
+    struct migration *m = &state->migr;
+
+    if (!m->pass_active) {
+        if (m->device_done) {
+            return false;
+        }
+        migr_start_pass(state);
+    }
+
+    while (m->next_page < m->nr_pages) {
+        size_t page = m->next_page++;
+        uint64_t hash;
+
+        if (!(m->resident[page] & 1)) {
+            continue;
+        }
+        /* Send a copy so the record matches its hash */
+        memcpy(m->page, state->mem + page * m->page_size, m->page_size);
+        hash = migr_hash(m->page, m->page_size);
+        if (hash == m->sent[page] || (!m->sent[page] && hash == m->zero_hash)) {
+            continue;
+        }
+        m->sent[page] = hash;
+        m->pass_pages++;
+        m->rec = (struct migr_record){
+            .type = MIGR_REC_MEMORY,
+            .len = m->page_size,
+            .offset = (uint64_t)page * m->page_size,
+        };
+        m->rec_done = 0;
+        return true;
+    }
+
+    m->pass_active = false;
+    vfu_log(state->vfu_ctx, LOG_DEBUG, "migration: %s pass sent %zu pages",
+            m->state == VFU_MIGR_STATE_STOP_AND_COPY ? "stop-and-copy" : "pre-copy",
+            m->pass_pages);
+
+    if (m->state != VFU_MIGR_STATE_STOP_AND_COPY) {
+        return false;
+    }
+
+    migr_save_device(state);
+    m->rec = (struct migr_record){ .type = MIGR_REC_DEVICE, .len = sizeof(m->dev) };
+    m->rec_done = 0;
+    m->device_done = true;
+    return true;
+}
+
+static ssize_t migration_read_data(vfu_ctx_t *vfu_ctx, void *buf, uint64_t count)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+    struct migration *m = &state->migr;
+    char *out = buf;
+    size_t done = 0;
+
+    if (!m->sent) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (done < count) {
+        const char *src;
+        size_t n;
+
+        if (m->rec_done == sizeof(m->rec) + m->rec.len && !migr_next_record(state)) {
+            break;
+        }
+
+        if (m->rec_done < sizeof(m->rec)) {
+            src = (const char *)&m->rec + m->rec_done;
+            n = sizeof(m->rec) - m->rec_done;
+        } else {
+            size_t off = m->rec_done - sizeof(m->rec);
+
+            src = (m->rec.type == MIGR_REC_MEMORY ? m->page : (const char *)&m->dev) + off;
+            n = m->rec.len - off;
+        }
+        n = migr_min(n, count - done);
+        memcpy(out + done, src, n);
+        m->rec_done += n;
+        done += n;
+    }
+    return done;
+}
+
+/* Validate a received record header before its payload is stored */
+static int migr_check_record(struct mock_accel_state *state)
+{
+    const struct migr_record *rec = &state->migr.rec;
+
+    switch (rec->type) {
+    case MIGR_REC_MEMORY:
+        return state->mem && rec->len && rec->len <= state->mem_bar_size &&
+               rec->offset <= state->mem_bar_size - rec->len ? 0 : -1;
+    case MIGR_REC_DEVICE:
+        if (rec->len < offsetof(struct migr_device_state, flags) ||
+            rec->len > sizeof(state->migr.dev)) {
+            return -1;
+        }
+        memset(&state->migr.dev, 0, sizeof(state->migr.dev));
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/*
+ * Register values from the stream get the checks their MMIO writes get in
+ * bar0_access() and ring_write(); the stream may be truncated, corrupted
+ * or hostile, and a batch above RESULT_SLOTS would overrun the result
+ * window once dma_resume() resubmits the command.
+ */
+static bool migr_device_valid(const struct migr_device_state *d)
+{
+    if (d->passphrase_length != 0 && (d->passphrase_length < 4 || d->passphrase_length > 12)) {
+        return false;
+    }
+    if (d->passphrase_batch > RESULT_SLOTS || d->passphrase_status > PASSPHRASE_ERROR ||
+        d->passphrase_bytes >= sizeof(d->passphrase_buffer)) {
+        return false;
+    }
+    if (d->ring_size > RING_MAX_SIZE || (d->ring_size & (d->ring_size - 1)) != 0 ||
+        d->ring_head - d->ring_tail > d->ring_size || d->ring_status > PASSPHRASE_ERROR) {
+        return false;
+    }
+    /* A doorbell is refused for a misaligned ring, see ring_write() */
+    if (d->ring_head != d->ring_tail &&
+        (d->ring_base & (sizeof(struct mock_accel_desc) - 1)) != 0) {
+        return false;
+    }
+    return true;
+}
+
+static int migr_load_device(struct mock_accel_state *state)
+{
+    const struct migr_device_state *d = &state->migr.dev;
+    vfu_ctx_t *vfu_ctx = state->vfu_ctx;
+
+    if (d->magic != MIGR_MAGIC || d->version == 0 || d->version > MIGR_VERSION ||
+        d->size != state->migr.rec.len) {
+        vfu_log(vfu_ctx, LOG_ERR, "migration: unsupported device state (version %u, %u bytes)",
+                d->version, d->size);
+        return -1;
+    }
+    if (!!(d->flags & MIGR_DEV_VF) != state->is_vf || d->memory_size != state->memory_size ||
+        d->mem_bar_size != state->mem_bar_size) {
+        vfu_log(vfu_ctx, LOG_ERR, "migration: source device has a different type or memory size");
+        return -1;
+    }
+    if (!migr_device_valid(d)) {
+        vfu_log(vfu_ctx, LOG_ERR, "migration: device state has invalid register values");
+        return -1;
+    }
+    if (memcmp(d->uuid, state->uuid_bytes, sizeof(d->uuid)) != 0) {
+        vfu_log(vfu_ctx, LOG_WARNING, "migration: source device UUID differs, keeping %s",
+                state->uuid);
+    }
+
+    pthread_mutex_lock(&state->lock);
+    /* Work in flight on the source restarts from dma_resume() once running */
+    state->dma_paused = true;
+    state->status = d->status;
+    state->passphrase_length = d->passphrase_length;
+    state->passphrase_status = d->passphrase_status;
+    state->passphrase_count = d->passphrase_count;
+    state->passphrase_bytes = d->passphrase_bytes;
+    state->passphrase_batch = d->passphrase_batch;
+    state->ring_base = d->ring_base;
+    state->ring_size = d->ring_size;
+    state->ring_head = d->ring_head;
+    state->ring_tail = d->ring_tail;
+    state->ring_status = d->ring_status;
+    memcpy(state->passphrase_buffer, d->passphrase_buffer, sizeof(state->passphrase_buffer));
+    state->passphrase_buffer[sizeof(state->passphrase_buffer) - 1] = '\0';
+    if (state->results) {
+        memcpy(state->results, d->results, sizeof(d->results));
+    }
+    info_page_update(state);
+    pthread_mutex_unlock(&state->lock);
+
+    if (!state->is_vf) {
+        memcpy(state->config, d->config, sizeof(d->config));
+        memcpy(state->config + PCI_CFG_SPACE_SIZE, d->sriov_cap, sizeof(d->sriov_cap));
+        memcpy(vfu_pci_get_config_space(vfu_ctx), state->config, PCI_CFG_SPACE_SIZE);
+    }
+
+    state->migr.device_done = true;
+    return 0;
+}
+
+static ssize_t migration_write_data(vfu_ctx_t *vfu_ctx, void *buf, uint64_t count)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+    struct migration *m = &state->migr;
+    const char *in = buf;
+    size_t done = 0;
+
+    while (done < count) {
+        char *dst;
+        size_t n;
+
+        if (m->rec_done < sizeof(m->rec)) {
+            dst = (char *)&m->rec + m->rec_done;
+            n = sizeof(m->rec) - m->rec_done;
+        } else {
+            size_t off = m->rec_done - sizeof(m->rec);
+
+            dst = (m->rec.type == MIGR_REC_MEMORY ? state->mem + m->rec.offset :
+                   (char *)&m->dev) + off;
+            n = m->rec.len - off;
+        }
+        n = migr_min(n, count - done);
+        memcpy(dst, in + done, n);
+        m->rec_done += n;
+        done += n;
+
+        if (m->rec_done == sizeof(m->rec) && migr_check_record(state) < 0) {
+            vfu_log(vfu_ctx, LOG_ERR, "migration: bad record (type %u, %u bytes at %#llx)",
+                    m->rec.type, m->rec.len, (unsigned long long)m->rec.offset);
+            errno = EINVAL;
+            return -1;
+        }
+        if (m->rec_done == sizeof(m->rec) + m->rec.len) {
+            if (m->rec.type == MIGR_REC_DEVICE && migr_load_device(state) < 0) {
+                errno = EINVAL;
+                return -1;
+            }
+            m->rec_done = 0;
+        }
+    }
+    return done;
+}
+
+static int migration_transition(vfu_ctx_t *vfu_ctx, vfu_migr_state_t to)
+{
+    struct mock_accel_state *state = vfu_get_private(vfu_ctx);
+    struct migration *m = &state->migr;
+
+    if (m->state == VFU_MIGR_STATE_RESUME && to != VFU_MIGR_STATE_RESUME &&
+        !m->device_done) {
+        vfu_log(vfu_ctx, LOG_ERR, "migration: stream ended without device state");
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (to) {
+    case VFU_MIGR_STATE_PRE_COPY:
+        if (migr_begin(state) < 0) {
+            return -1;
+        }
+        break;
+    case VFU_MIGR_STATE_STOP_AND_COPY:
+        device_quiesce(state);
+        if (!m->sent && migr_begin(state) < 0) {
+            return -1;
+        }
+        /* Final pass from the first page; a record in progress completes first */
+        m->pass_active = false;
+        break;
+    case VFU_MIGR_STATE_STOP:
+        device_quiesce(state);
+        migr_end(state);
+        break;
+    case VFU_MIGR_STATE_RUNNING:
+        migr_end(state);
+        break;
+    case VFU_MIGR_STATE_RESUME:
+        migr_end(state);
+        break;
+    }
+
+    vfu_log(vfu_ctx, LOG_DEBUG, "migration: state %d -> %d", m->state, to);
+    m->state = to;
+    return 0;
+}
+
+static const vfu_migration_callbacks_t migration_callbacks = {
+    .version = VFU_MIGR_CALLBACKS_VERS,
+    .transition = migration_transition,
+    .read_data = migration_read_data,
+    .write_data = migration_write_data,
+};
+
+static uint64_t parse_size(const char *str)
+{
+    char *end;
+    uint64_t value = strtoull(str, &end, 10);
+
+    switch (*end) {
+    case 'G': case 'g': value *= 1024 * 1024 * 1024; break;
+    case 'M': case 'm': value *= 1024 * 1024; break;
+    case 'K': case 'k': value *= 1024; break;
+    }
+    return value;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS] <socket_path>\n", prog);
+    fprintf(stderr, "       %s [OPTIONS] --device SPEC [--device SPEC ...]\n", prog);
+    fprintf(stderr, "       %s [OPTIONS] --config FILE\n", prog);
     fprintf(stderr, "\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -v              Verbose logging\n");
     fprintf(stderr, "  -u UUID         Device UUID (default: MOCK-0000-0001)\n");
     fprintf(stderr, "  -m SIZE         Memory size, e.g., 16G (default: 16G for PF, 2G for VF)\n");
+    fprintf(stderr, "  --memory-bar    Back the device memory with a mappable BAR2 (memfd)\n");
+    fprintf(stderr, "  --hugepages     Use hugetlbfs pages for BAR2 (implies --memory-bar)\n");
+    fprintf(stderr, "  --prefault      Populate BAR2 at startup (implies --memory-bar)\n");
     fprintf(stderr, "  --vf            Run as Virtual Function (Device ID 0x0002)\n");
     fprintf(stderr, "  --total-vfs N   Total VFs supported by PF (default: 4, max: %d)\n", MAX_VFS);
+    fprintf(stderr, "  --device SPEC   Serve an additional device (repeatable, max %d)\n", MAX_DEVICES);
+    fprintf(stderr, "  --config FILE   Read device SPECs from FILE, one per line\n");
+    fprintf(stderr, "  --workers N     Execute device commands on N worker threads\n");
+    fprintf(stderr, "                  (default: 0, commands run on the event loop)\n");
+    fprintf(stderr, "  --cpus LIST     Pin workers to CPUs, e.g. 4-7 or 0,2,4-6\n");
+    fprintf(stderr, "                  (implies one worker per CPU unless --workers is set)\n");
+    fprintf(stderr, "  --numa-node N   Run all threads and allocate all memory on NUMA node N\n");
+    fprintf(stderr, "  --stats-socket PATH\n");
+    fprintf(stderr, "                  Serve register and latency stats (Prometheus text) on PATH\n");
+    fprintf(stderr, "  --persistent    Keep serving after a client disconnects: reset the\n");
+    fprintf(stderr, "                  devices and accept the next client on the same socket\n");
+    fprintf(stderr, "  --wordlist PATH Wordlist text file or compiled image (see mkwordlist)\n");
+    fprintf(stderr, "                  (default: built-in table if embedded, else searched\n");
+    fprintf(stderr, "                  next to the executable, in vfio-user/ and in .)\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Device SPEC is a comma-separated list of:\n");
+    fprintf(stderr, "  socket=PATH,uuid=UUID,memory=SIZE,vf,vf-index=N,total-vfs=N,\n");
+    fprintf(stderr, "  memory-bar,hugepages,prefault\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "Examples:\n");
     fprintf(stderr, "  # Physical Function with 4 VFs\n");
@@ -494,115 +2342,542 @@ static void usage(const char *prog)
     fprintf(stderr, "\n");
     fprintf(stderr, "  # Virtual Function\n");
     fprintf(stderr, "  %s -u MOCK-VF-0 -m 2G --vf /tmp/mock-vf-0-0.sock\n", prog);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  # PF and two VFs in one process\n");
+    fprintf(stderr, "  %s --device socket=/tmp/pf.sock,uuid=PF0,total-vfs=2 \\\n", prog);
+    fprintf(stderr, "      --device socket=/tmp/vf0.sock,uuid=VF0,vf,vf-index=0 \\\n");
+    fprintf(stderr, "      --device socket=/tmp/vf1.sock,uuid=VF1,vf,vf-index=1\n");
     exit(EXIT_FAILURE);
 }
 
-int main(int argc, char *argv[])
+static void init_device_state(struct mock_accel_state *state)
+{
+    memset(state, 0, sizeof(*state));
+    strcpy(state->uuid, "MOCK-0000-0001");
+    state->memory_size = 0;  /* Will be set based on is_vf */
+    state->capabilities = CAP_COMPUTE | CAP_RING | CAP_INFO_PAGE | CAP_DMA_ENGINE |
+                          CAP_RESULT_WINDOW;
+    state->status = STATUS_READY;
+    state->is_vf = false;
+    state->total_vfs = 4;  /* Default: 4 VFs */
+    state->vf_index = 0;
+    state->poll_fd = -1;
+    state->mem_fd = -1;
+    state->migr.state = VFU_MIGR_STATE_RUNNING;
+}
+
+/*
+ * Parse a device SPEC (socket=PATH,uuid=UUID,memory=SIZE,vf,vf-index=N,
+ * total-vfs=N,memory-bar,hugepages,prefault) into state. Returns 0 on
+ * success, -1 on error.
+ */
+static int parse_device_spec(const char *spec, struct mock_accel_state *state)
+{
+    enum {
+        OPT_SOCKET, OPT_UUID, OPT_MEMORY, OPT_VF, OPT_VF_INDEX, OPT_TOTAL_VFS,
+        OPT_MEMORY_BAR, OPT_HUGEPAGES, OPT_PREFAULT,
+    };
+    char *const tokens[] = {
+        [OPT_SOCKET]     = "socket",
+        [OPT_UUID]       = "uuid",
+        [OPT_MEMORY]     = "memory",
+        [OPT_VF]         = "vf",
+        [OPT_VF_INDEX]   = "vf-index",
+        [OPT_TOTAL_VFS]  = "total-vfs",
+        [OPT_MEMORY_BAR] = "memory-bar",
+        [OPT_HUGEPAGES]  = "hugepages",
+        [OPT_PREFAULT]   = "prefault",
+        NULL
+    };
+    char *copy = strdup(spec);
+    char *subopts = copy;
+    char *value;
+    int ret = 0;
+
+    if (!copy) {
+        return -1;
+    }
+
+    init_device_state(state);
+
+    while (*subopts != '\0' && ret == 0) {
+        int opt = getsubopt(&subopts, tokens, &value);
+
+        bool flag = opt == OPT_VF || opt == OPT_MEMORY_BAR || opt == OPT_HUGEPAGES ||
+                    opt == OPT_PREFAULT;
+
+        if (!flag && opt >= 0 && value == NULL) {
+            fprintf(stderr, "Error: '%s' requires a value in device spec '%s'\n",
+                    tokens[opt], spec);
+            ret = -1;
+            break;
+        }
+
+        switch (opt) {
+        case OPT_SOCKET:
+            strncpy(state->socket_path, value, sizeof(state->socket_path) - 1);
+            break;
+        case OPT_UUID:
+            strncpy(state->uuid, value, sizeof(state->uuid) - 1);
+            break;
+        case OPT_MEMORY:
+            state->memory_size = parse_size(value);
+            state->memory_size_set = true;
+            break;
+        case OPT_VF:
+            state->is_vf = true;
+            break;
+        case OPT_VF_INDEX:
+            state->vf_index = (uint16_t)atoi(value);
+            break;
+        case OPT_TOTAL_VFS:
+            state->total_vfs = (uint16_t)atoi(value);
+            if (state->total_vfs > MAX_VFS) {
+                fprintf(stderr, "Error: total-vfs cannot exceed %d\n", MAX_VFS);
+                ret = -1;
+            }
+            break;
+        case OPT_MEMORY_BAR:
+            if (state->mem_bar == MEM_BAR_NONE) {
+                state->mem_bar = MEM_BAR_MEMFD;
+            }
+            break;
+        case OPT_HUGEPAGES:
+            state->mem_bar = MEM_BAR_HUGETLB;
+            break;
+        case OPT_PREFAULT:
+            if (state->mem_bar == MEM_BAR_NONE) {
+                state->mem_bar = MEM_BAR_MEMFD;
+            }
+            state->mem_prefault = true;
+            break;
+        default:
+            fprintf(stderr, "Error: unknown option '%s' in device spec '%s'\n",
+                    value, spec);
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret == 0 && state->socket_path[0] == '\0') {
+        fprintf(stderr, "Error: device spec '%s' has no socket\n", spec);
+        ret = -1;
+    }
+
+    free(copy);
+    return ret;
+}
+
+/*
+ * Read device SPECs from a config file, one per line. Blank lines and
+ * lines starting with '#' are ignored.
+ */
+static int parse_config_file(const char *path, struct mock_accel_state *devices,
+                             int *nr_devices)
+{
+    FILE *fp = fopen(path, "r");
+    char line[PATH_MAX + 256];
+    int lineno = 0;
+
+    if (!fp) {
+        fprintf(stderr, "Error: cannot open config file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line;
+        char *end;
+
+        lineno++;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        end = p + strlen(p);
+        while (end > p && (end[-1] == '\n' || end[-1] == '\r' ||
+                           end[-1] == ' ' || end[-1] == '\t')) {
+            *--end = '\0';
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+
+        if (*nr_devices >= MAX_DEVICES) {
+            fprintf(stderr, "Error: %s:%d: too many devices (max %d)\n",
+                    path, lineno, MAX_DEVICES);
+            fclose(fp);
+            return -1;
+        }
+        if (parse_device_spec(p, &devices[*nr_devices]) < 0) {
+            fprintf(stderr, "Error: %s:%d: invalid device spec\n", path, lineno);
+            fclose(fp);
+            return -1;
+        }
+        (*nr_devices)++;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/*
+ * Parse a CPU list such as "4-7" or "0,2,4-6" into cpus[]. Returns the
+ * number of CPUs, or -1 on error.
+ */
+static int parse_cpu_list(const char *str, int *cpus, int max_cpus)
+{
+    const char *p = str;
+    int n = 0;
+
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+
+        if (end == p || first < 0) {
+            return -1;
+        }
+        p = end;
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return -1;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (n >= max_cpus || cpu >= CPU_SETSIZE) {
+                return -1;
+            }
+            cpus[n++] = (int)cpu;
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Bind [addr, addr + len) to the --numa-node node, moving pages that are
+ * already allocated. For a shared mapping the policy belongs to the file,
+ * so it also governs pages faulted in by other processes mapping it.
+ */
+static void numa_bind_range(void *addr, size_t len)
+{
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page - 1);
+    uintptr_t end = ((uintptr_t)addr + len + page - 1) & ~(page - 1);
+
+    if (numa_node < 0) {
+        return;
+    }
+    if (syscall(SYS_mbind, start, end - start, MPOL_BIND, numa_nodemask,
+                MAX_NUMA_NODES + 1, MPOL_MF_MOVE) < 0) {
+        warn("mbind to NUMA node %d failed", numa_node);
+    }
+}
+
+/*
+ * Restrict the process to one NUMA node: pin the calling thread (and so
+ * every thread created later) to the node's CPUs and make the node the
+ * only source of memory for future allocations. Memory allocated before
+ * this is moved with numa_bind_range().
+ */
+static void numa_bind(int node)
 {
-    struct mock_accel_state state = {
-        .uuid = "MOCK-0000-0001",
-        .memory_size = 0,  /* Will be set based on is_vf */
-        .capabilities = CAP_COMPUTE,
-        .status = STATUS_READY,
-        .is_vf = false,
-        .total_vfs = 4,  /* Default: 4 VFs */
-        .vf_index = 0,
-    };
+    char path[64], cpulist[4096];
+    int cpus[CPU_SETSIZE];
+    int nr_cpus;
+    cpu_set_t set;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    fp = fopen(path, "r");
+    if (!fp) {
+        errx(EXIT_FAILURE, "NUMA node %d does not exist", node);
+    }
+    if (!fgets(cpulist, sizeof(cpulist), fp)) {
+        cpulist[0] = '\0';
+    }
+    fclose(fp);
+    cpulist[strcspn(cpulist, "\n")] = '\0';
+
+    /* Memory-only nodes have no CPUs; keep the default affinity then */
+    nr_cpus = parse_cpu_list(cpulist, cpus, CPU_SETSIZE);
+    if (nr_cpus > 0) {
+        CPU_ZERO(&set);
+        for (int i = 0; i < nr_cpus; i++) {
+            CPU_SET(cpus[i], &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            err(EXIT_FAILURE, "failed to bind to the CPUs of NUMA node %d", node);
+        }
+    } else {
+        fprintf(stderr, "Warning: NUMA node %d has no CPUs, binding memory only\n", node);
+    }
 
-    bool verbose = false;
-    bool memory_size_set = false;
-    int opt;
-    int option_index = 0;
+    numa_nodemask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_set_mempolicy, MPOL_BIND, numa_nodemask, MAX_NUMA_NODES + 1) < 0) {
+        err(EXIT_FAILURE, "set_mempolicy for NUMA node %d failed", node);
+    }
+    numa_node = node;
 
-    static struct option long_options[] = {
-        {"vf",        no_argument,       0, 'V'},
-        {"vf-index",  required_argument, 0, 'I'},
-        {"total-vfs", required_argument, 0, 'T'},
-        {"help",      no_argument,       0, 'h'},
-        {0, 0, 0, 0}
-    };
+    printf("Bound to NUMA node %d (CPUs %s)\n", node, nr_cpus > 0 ? cpulist : "none");
+}
 
-    while ((opt = getopt_long(argc, argv, "vu:m:h", long_options, &option_index)) != -1) {
-        switch (opt) {
-        case 'v':
-            verbose = true;
-            break;
-        case 'u':
-            strncpy(state.uuid, optarg, sizeof(state.uuid) - 1);
-            break;
-        case 'm':
-            state.memory_size = parse_size(optarg);
-            memory_size_set = true;
-            break;
-        case 'V':  /* --vf */
-            state.is_vf = true;
-            break;
-        case 'I':  /* --vf-index */
-            state.vf_index = (uint16_t)atoi(optarg);
-            break;
-        case 'T':  /* --total-vfs */
-            state.total_vfs = (uint16_t)atoi(optarg);
-            if (state.total_vfs > MAX_VFS) {
-                fprintf(stderr, "Error: total-vfs cannot exceed %d\n", MAX_VFS);
-                exit(EXIT_FAILURE);
+static void start_workers(struct worker *workers, int nr_workers,
+                          const int *cpus, int nr_cpus)
+{
+    for (int i = 0; i < nr_workers; i++) {
+        struct worker *w = &workers[i];
+        char name[16];
+
+        w->index = i;
+        w->cpu = nr_cpus > 0 ? cpus[i % nr_cpus] : -1;
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_cond_init(&w->cond, NULL);
+
+        int ret = pthread_create(&w->thread, NULL, worker_main, w);
+        if (ret != 0) {
+            errno = ret;
+            err(EXIT_FAILURE, "failed to start worker %d", i);
+        }
+
+        /* Thread names are limited to 15 characters */
+        snprintf(name, sizeof(name), "mock-accel-w%u", (unsigned int)i % 1000);
+        pthread_setname_np(w->thread, name);
+
+        if (w->cpu >= 0) {
+            cpu_set_t set;
+
+            CPU_ZERO(&set);
+            CPU_SET(w->cpu, &set);
+            ret = pthread_setaffinity_np(w->thread, sizeof(set), &set);
+            if (ret != 0) {
+                errno = ret;
+                warn("failed to pin worker %d to CPU %d", i, w->cpu);
             }
-            break;
-        case 'h':
-        default:
-            usage(argv[0]);
         }
     }
 
-    /* Set default memory size based on function type if not explicitly set */
-    if (!memory_size_set) {
-        state.memory_size = state.is_vf ? DEFAULT_VF_MEMORY_SIZE : DEFAULT_MEMORY_SIZE;
+    printf("Started %d command worker(s)", nr_workers);
+    if (nr_cpus > 0) {
+        printf(" pinned to %d CPU(s)", nr_cpus);
+    }
+    printf("\n");
+}
+
+static void stop_workers(struct worker *workers, int nr_workers)
+{
+    for (int i = 0; i < nr_workers; i++) {
+        pthread_mutex_lock(&workers[i].lock);
+        workers[i].stop = true;
+        pthread_cond_signal(&workers[i].cond);
+        pthread_mutex_unlock(&workers[i].lock);
     }
+    for (int i = 0; i < nr_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+}
 
-    if (optind >= argc) {
-        fprintf(stderr, "Error: missing socket path\n\n");
-        usage(argv[0]);
+/*
+ * Build SR-IOV extended capability for PF
+ */
+static void build_sriov_cap(struct mock_accel_state *state)
+{
+    size_t offset = 0;
+
+    /* Extended Capability Header (4 bytes)
+     * Bits 15:0  - Capability ID (0x0010 for SR-IOV)
+     * Bits 19:16 - Version (0x1)
+     * Bits 31:20 - Next Capability Offset (0x000)
+     */
+    state->sriov_cap[offset++] = PCI_EXT_CAP_ID_SRIOV;  /* ID low byte: 0x10 */
+    state->sriov_cap[offset++] = 0x00;                   /* ID high byte: 0x00 */
+    state->sriov_cap[offset++] = 0x01;                   /* Version[3:0]=1 | Next[3:0]=0 */
+    state->sriov_cap[offset++] = 0x00;                   /* Next[11:4] = 0x00 */
+
+    /* SR-IOV Capabilities (4 bytes at offset 0x04) */
+    state->sriov_cap[offset++] = 0x01;  /* VF Migration Capable */
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+
+    /* SR-IOV Control (2 bytes at offset 0x08) - initially 0 (VF disabled) */
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+
+    /* SR-IOV Status (2 bytes at offset 0x0a) */
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+
+    /* InitialVFs (2 bytes at offset 0x0c) */
+    state->sriov_cap[offset++] = state->total_vfs & 0xff;
+    state->sriov_cap[offset++] = (state->total_vfs >> 8) & 0xff;
+
+    /* TotalVFs (2 bytes at offset 0x0e) */
+    state->sriov_cap[offset++] = state->total_vfs & 0xff;
+    state->sriov_cap[offset++] = (state->total_vfs >> 8) & 0xff;
+
+    /* NumVFs (2 bytes at offset 0x10) - initially 0 */
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+
+    /* Function Dependency Link (1 byte at offset 0x12) */
+    state->sriov_cap[offset++] = 0x00;
+
+    /* Reserved (1 byte at offset 0x13) */
+    state->sriov_cap[offset++] = 0x00;
+
+    /* First VF Offset (2 bytes at offset 0x14) - VFs start at function 1 */
+    state->sriov_cap[offset++] = 0x01;  /* Offset = 1 */
+    state->sriov_cap[offset++] = 0x00;
+
+    /* VF Stride (2 bytes at offset 0x16) - VFs are consecutive */
+    state->sriov_cap[offset++] = 0x01;  /* Stride = 1 */
+    state->sriov_cap[offset++] = 0x00;
+
+    /* Reserved (2 bytes at offset 0x18) */
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+
+    /* VF Device ID (2 bytes at offset 0x1a) */
+    state->sriov_cap[offset++] = MOCK_ACCEL_VF_DEVICE_ID & 0xff;
+    state->sriov_cap[offset++] = (MOCK_ACCEL_VF_DEVICE_ID >> 8) & 0xff;
+
+    /* Supported Page Sizes (4 bytes at offset 0x1c) - 4K, 8K, 64K, 256K, 1M, 4M */
+    state->sriov_cap[offset++] = 0x53;
+    state->sriov_cap[offset++] = 0x05;
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+
+    /* System Page Size (4 bytes at offset 0x20) - 4K until the guest picks one */
+    state->sriov_cap[offset++] = 0x01;
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+    state->sriov_cap[offset++] = 0x00;
+
+    /* VF BAR0-5 and VF Migration State Array Offset (0x24-0x3f) - not implemented */
+    while (offset < PCI_EXT_CAP_SRIOV_SIZEOF) {
+        state->sriov_cap[offset++] = 0x00;
     }
 
-    const char *socket_path = argv[optind];
+    /* Save the capability size */
+    state->sriov_cap_size = offset;
 
-    /* Parse UUID into bytes */
-    parse_uuid(&state);
+    printf("Built SR-IOV capability (%zu bytes, TotalVFs=%d)\n",
+           state->sriov_cap_size, state->total_vfs);
+    printf("SR-IOV capability will be provided via config space callback\n");
+}
 
-    /* Load EFF wordlist for passphrase generation */
-    if (load_wordlist(&state) < 0) {
-        fprintf(stderr, "Warning: Failed to load wordlist, passphrase generation disabled\n");
-    } else {
-        printf("Loaded EFF wordlist (7776 words)\n");
+/*
+ * Create the BAR2 backing memfd and the server's own mapping of it. The
+ * client maps the same pages into the guest, so unless prefaulting they
+ * are only allocated once the guest touches them.
+ */
+static void setup_memory_bar(struct mock_accel_state *state)
+{
+    unsigned int flags = MFD_CLOEXEC;
+    uint64_t size = MEMORY_BAR_MIN_SIZE;
+
+    if (state->mem_bar == MEM_BAR_HUGETLB) {
+        flags |= MFD_HUGETLB;
+        size = HUGEPAGE_SIZE;
+    }
+    while (size < state->memory_size && size < MEMORY_BAR_MAX_SIZE) {
+        size <<= 1;
+    }
+    if (size < state->memory_size) {
+        fprintf(stderr, "Warning: %s: BAR2 limited to the first %llu MB of device memory\n",
+                state->socket_path, (unsigned long long)(size >> 20));
     }
 
-    /* Set up signal handler */
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    state->mem_fd = memfd_create("mock-accel-mem", flags);
+    if (state->mem_fd < 0) {
+        err(EXIT_FAILURE, "memfd for BAR2 failed%s",
+            flags & MFD_HUGETLB ? " (are hugepages reserved?)" : "");
+    }
+    if (ftruncate(state->mem_fd, size) < 0) {
+        err(EXIT_FAILURE, "sizing BAR2 memfd failed");
+    }
+    state->mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | (state->mem_prefault ? MAP_POPULATE : 0),
+                      state->mem_fd, 0);
+    if (state->mem == MAP_FAILED) {
+        err(EXIT_FAILURE, "mmap BAR2 failed");
+    }
+
+    /*
+     * The guest faults these pages in through QEMU, not this process.
+     * hugetlbfs keeps no per-file policy, so combine --hugepages with
+     * --prefault to control placement.
+     */
+    numa_bind_range(state->mem, size);
+
+    state->mem_bar_size = size;
+    state->capabilities |= CAP_MEMORY_BAR;
+}
+
+/*
+ * Create and realize the vfio-user context for one device. The context is
+ * created in non-blocking mode so it can be driven from the shared epoll
+ * loop.
+ */
+static void setup_device(struct mock_accel_state *state, bool verbose)
+{
+    /* Set default memory size based on function type if not explicitly set */
+    if (!state->memory_size_set) {
+        state->memory_size = state->is_vf ? DEFAULT_VF_MEMORY_SIZE : DEFAULT_MEMORY_SIZE;
+    }
+
+    /* Parse UUID into bytes */
+    parse_uuid(state);
+
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_mutex_init(&state->dma_lock, NULL);
+    pthread_cond_init(&state->idle, NULL);
+
+    state->dma_sg = calloc(DMA_SG_COUNT, dma_sg_size());
+    if (!state->dma_sg) {
+        err(EXIT_FAILURE, "failed to allocate DMA scatter-gather list");
+    }
 
-    uint16_t device_id = state.is_vf ? MOCK_ACCEL_VF_DEVICE_ID : MOCK_ACCEL_PF_DEVICE_ID;
+    uint16_t device_id = state->is_vf ? MOCK_ACCEL_VF_DEVICE_ID : MOCK_ACCEL_PF_DEVICE_ID;
 
     printf("Mock Accelerator Server\n");
-    if (state.is_vf) {
-        printf("  Type:   Virtual Function (VF %d)\n", state.vf_index);
+    if (state->is_vf) {
+        printf("  Type:   Virtual Function (VF %d)\n", state->vf_index);
     } else {
         printf("  Type:   Physical Function\n");
     }
-    printf("  Socket: %s\n", socket_path);
-    printf("  UUID:   %s\n", state.uuid);
-    printf("  Memory: %lu bytes (%.1f GB)\n", state.memory_size,
-           (double)state.memory_size / (1024 * 1024 * 1024));
+    printf("  Socket: %s\n", state->socket_path);
+    printf("  UUID:   %s\n", state->uuid);
+    printf("  Memory: %lu bytes (%.1f GB)\n", state->memory_size,
+           (double)state->memory_size / (1024 * 1024 * 1024));
+    if (state->mem_bar != MEM_BAR_NONE) {
+        setup_memory_bar(state);
+        printf("  BAR2:   %lu MB %s%s\n", state->mem_bar_size >> 20,
+               state->mem_bar == MEM_BAR_HUGETLB ? "hugetlb" : "memfd",
+               state->mem_prefault ? ", prefaulted" : "");
+    }
     printf("  PCI ID: %04x:%04x\n", MOCK_ACCEL_VENDOR_ID, device_id);
-    if (!state.is_vf && state.total_vfs > 0) {
-        printf("  SR-IOV: %d VFs\n", state.total_vfs);
+    if (!state->is_vf && state->total_vfs > 0) {
+        printf("  SR-IOV: %d VFs\n", state->total_vfs);
     }
     printf("\n");
 
     /* Create vfio-user context */
-    vfu_ctx_t *vfu_ctx = vfu_create_ctx(VFU_TRANS_SOCK, socket_path, 0,
-                                         &state, VFU_DEV_TYPE_PCI);
+    vfu_ctx_t *vfu_ctx = vfu_create_ctx(VFU_TRANS_SOCK, state->socket_path,
+                                         LIBVFIO_USER_FLAG_ATTACH_NB,
+                                         state, VFU_DEV_TYPE_PCI);
     if (vfu_ctx == NULL) {
-        err(EXIT_FAILURE, "vfu_create_ctx failed");
+        err(EXIT_FAILURE, "vfu_create_ctx failed for %s", state->socket_path);
     }
+    state->vfu_ctx = vfu_ctx;
 
     /* Set up logging */
     if (vfu_setup_log(vfu_ctx, log_fn, verbose ? LOG_DEBUG : LOG_INFO) < 0) {
@@ -619,7 +2894,7 @@ int main(int argc, char *argv[])
                    MOCK_ACCEL_SUBSYS_VENDOR_ID, MOCK_ACCEL_SUBSYS_ID);
 
     /* Set up config space region with extended size for PF only (for SR-IOV capability) */
-    if (!state.is_vf) {
+    if (!state->is_vf) {
         if (vfu_setup_region(vfu_ctx, VFU_PCI_DEV_CFG_REGION_IDX, 4096,
                              &config_space_access, VFU_REGION_FLAG_RW | VFU_REGION_FLAG_ALWAYS_CB,
                              NULL, 0, -1, 0) < 0) {
@@ -628,118 +2903,469 @@ int main(int argc, char *argv[])
     }
     /* VFs use default 256-byte config space */
 
-    /* Build SR-IOV extended capability for PF */
-    if (!state.is_vf && state.total_vfs > 0) {
-        size_t offset = 0;
+    if (!state->is_vf && state->total_vfs > 0) {
+        build_sriov_cap(state);
+    }
 
-        /* Extended Capability Header (4 bytes)
-         * Bits 15:0  - Capability ID (0x0010 for SR-IOV)
-         * Bits 19:16 - Version (0x1)
-         * Bits 31:20 - Next Capability Offset (0x000)
-         */
-        state.sriov_cap[offset++] = PCI_EXT_CAP_ID_SRIOV;  /* ID low byte: 0x10 */
-        state.sriov_cap[offset++] = 0x00;                   /* ID high byte: 0x00 */
-        state.sriov_cap[offset++] = 0x01;                   /* Version[3:0]=1 | Next[3:0]=0 */
-        state.sriov_cap[offset++] = 0x00;                   /* Next[11:4] = 0x00 */
+    /* MSI-X for completion interrupts, table and PBA live in BAR0 */
+    struct msixcap msix = {
+        .hdr = { .id = PCI_CAP_ID_MSIX },
+        .mxc = { .ts = MSIX_NR_VECTORS - 1 },
+        .mtab = { .tbir = 0, .to = MSIX_TABLE_OFFSET >> 3 },
+        .mpba = { .pbir = 0, .pbao = MSIX_PBA_OFFSET >> 3 },
+    };
+    if (vfu_pci_add_capability(vfu_ctx, 0, 0, &msix) < 0) {
+        err(EXIT_FAILURE, "vfu_pci_add_capability (MSI-X) failed");
+    }
+    if (vfu_setup_device_nr_irqs(vfu_ctx, VFU_DEV_MSIX_IRQ, MSIX_NR_VECTORS) < 0) {
+        err(EXIT_FAILURE, "vfu_setup_device_nr_irqs failed");
+    }
 
-        /* SR-IOV Capabilities (4 bytes at offset 0x04) */
-        state.sriov_cap[offset++] = 0x01;  /* VF Migration Capable */
-        state.sriov_cap[offset++] = 0x00;
-        state.sriov_cap[offset++] = 0x00;
-        state.sriov_cap[offset++] = 0x00;
+    /* BAR0 backing file; only the info page and result window are ever mapped */
+    state->info_fd = memfd_create("mock-accel-bar0", MFD_CLOEXEC);
+    if (state->info_fd < 0 || ftruncate(state->info_fd, BAR0_SIZE) < 0) {
+        err(EXIT_FAILURE, "memfd for BAR0 info page failed");
+    }
+    state->info_page = mmap(NULL, MAPPED_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            state->info_fd, MAPPED_OFFSET);
+    if (state->info_page == MAP_FAILED) {
+        err(EXIT_FAILURE, "mmap BAR0 info page failed");
+    }
+    state->results = (struct result_slot *)(state->info_page +
+                                            (RESULT_WINDOW_OFFSET - MAPPED_OFFSET));
+    pthread_mutex_lock(&state->lock);
+    info_page_update(state);
+    pthread_mutex_unlock(&state->lock);
+
+    /* Set up BAR0 region: page 0 traps, pages 1-2 are a sparse mmap area */
+    struct iovec bar0_mmap_areas[] = {
+        { .iov_base = (void *)MAPPED_OFFSET, .iov_len = MAPPED_SIZE },
+    };
+    if (vfu_setup_region(vfu_ctx, VFU_PCI_DEV_BAR0_REGION_IDX, BAR0_SIZE,
+                         &bar0_access, VFU_REGION_FLAG_RW, bar0_mmap_areas, 1,
+                         state->info_fd, 0) < 0) {
+        err(EXIT_FAILURE, "vfu_setup_region failed");
+    }
 
-        /* SR-IOV Control (2 bytes at offset 0x08) - initially 0 (VF disabled) */
-        state.sriov_cap[offset++] = 0x00;
-        state.sriov_cap[offset++] = 0x00;
+    /* Set up BAR2 region: device memory, mappable as a whole */
+    if (state->mem_fd >= 0) {
+        struct iovec mem_mmap_areas[] = {
+            { .iov_base = (void *)0, .iov_len = state->mem_bar_size },
+        };
+        if (vfu_setup_region(vfu_ctx, VFU_PCI_DEV_BAR2_REGION_IDX, state->mem_bar_size,
+                             &memory_bar_access, VFU_REGION_FLAG_RW | VFU_REGION_FLAG_MEM,
+                             mem_mmap_areas, 1, state->mem_fd, 0) < 0) {
+            err(EXIT_FAILURE, "vfu_setup_region (BAR2) failed");
+        }
+    }
 
-        /* SR-IOV Status (2 bytes at offset 0x0a) */
-        state.sriov_cap[offset++] = 0x00;
-        state.sriov_cap[offset++] = 0x00;
+    /* Set up device reset callback */
+    if (vfu_setup_device_reset_cb(vfu_ctx, &device_reset) < 0) {
+        err(EXIT_FAILURE, "vfu_setup_device_reset_cb failed");
+    }
 
-        /* InitialVFs (2 bytes at offset 0x0c) */
-        state.sriov_cap[offset++] = state.total_vfs & 0xff;
-        state.sriov_cap[offset++] = (state.total_vfs >> 8) & 0xff;
+    /* Track guest memory for the descriptor ring */
+    if (vfu_setup_device_dma(vfu_ctx, &dma_register, &dma_unregister) < 0) {
+        err(EXIT_FAILURE, "vfu_setup_device_dma failed");
+    }
+    vfu_setup_device_quiesce_cb(vfu_ctx, &device_quiesce_cb);
 
-        /* TotalVFs (2 bytes at offset 0x0e) */
-        state.sriov_cap[offset++] = state.total_vfs & 0xff;
-        state.sriov_cap[offset++] = (state.total_vfs >> 8) & 0xff;
+    /* Live migration with pre-copy of BAR2 */
+    if (vfu_setup_device_migration_callbacks(vfu_ctx, LIBVFIO_USER_MIG_FLAG_PRE_COPY,
+                                             &migration_callbacks) < 0) {
+        err(EXIT_FAILURE, "vfu_setup_device_migration_callbacks failed");
+    }
 
-        /* NumVFs (2 bytes at offset 0x10) - initially 0 */
-        state.sriov_cap[offset++] = 0x00;
-        state.sriov_cap[offset++] = 0x00;
+    /* Realize the device */
+    if (vfu_realize_ctx(vfu_ctx) < 0) {
+        err(EXIT_FAILURE, "vfu_realize_ctx failed");
+    }
 
-        /* Function Dependency Link (1 byte at offset 0x12) */
-        state.sriov_cap[offset++] = 0x00;
+    if (!state->is_vf) {
+        config_setup(state);
+    }
+}
 
-        /* Reserved (1 byte at offset 0x13) */
-        state.sriov_cap[offset++] = 0x00;
+/*
+ * Point the epoll registration for a device at its current poll fd. The fd
+ * is the listening socket until a client attaches, then the connection.
+ */
+static void update_poll_fd(int epfd, struct mock_accel_state *state)
+{
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.ptr = state,
+    };
+    int fd = vfu_get_poll_fd(state->vfu_ctx);
 
-        /* First VF Offset (2 bytes at offset 0x14) - VFs start at function 1 */
-        state.sriov_cap[offset++] = 0x01;  /* Offset = 1 */
-        state.sriov_cap[offset++] = 0x00;
+    if (fd == state->poll_fd) {
+        return;
+    }
 
-        /* VF Stride (2 bytes at offset 0x16) - VFs are consecutive */
-        state.sriov_cap[offset++] = 0x01;  /* Stride = 1 */
-        state.sriov_cap[offset++] = 0x00;
+    /* The old fd may already be closed by libvfio-user; ignore errors */
+    if (state->poll_fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, state->poll_fd, NULL);
+    }
 
-        /* Reserved (2 bytes at offset 0x18) */
-        state.sriov_cap[offset++] = 0x00;
-        state.sriov_cap[offset++] = 0x00;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        err(EXIT_FAILURE, "epoll_ctl failed for %s", state->socket_path);
+    }
+    state->poll_fd = fd;
+}
 
-        /* VF Device ID (2 bytes at offset 0x1a) */
-        state.sriov_cap[offset++] = MOCK_ACCEL_VF_DEVICE_ID & 0xff;
-        state.sriov_cap[offset++] = (MOCK_ACCEL_VF_DEVICE_ID >> 8) & 0xff;
+/*
+ * Give a device whose client went away (--persistent) to the next client.
+ * Everything the client could change returns to its power-on value, BAR2
+ * included so each client starts from zeroed device memory; the wordlist,
+ * mappings and stats stay.
+ */
+static void device_detached(int epfd, struct mock_accel_state *state)
+{
+    device_quiesce(state);
+    device_reset(state->vfu_ctx, VFU_RESET_LOST_CONN);
 
-        /* Save the capability size */
-        state.sriov_cap_size = offset;
+    /* The client's DMA regions went with it; the reset ring has no work */
+    pthread_mutex_lock(&state->lock);
+    state->dma_paused = false;
+    pthread_mutex_unlock(&state->lock);
 
-        printf("Built SR-IOV capability (%zu bytes, TotalVFs=%d)\n",
-               state.sriov_cap_size, state.total_vfs);
-        printf("SR-IOV capability will be provided via config space callback\n");
+    if (!state->is_vf) {
+        memcpy(state->config, state->config_default, PCI_CFG_SPACE_EXP_SIZE);
+        memcpy(vfu_pci_get_config_space(state->vfu_ctx), state->config, PCI_CFG_SPACE_SIZE);
     }
 
-    /* Set up BAR0 region */
-    if (vfu_setup_region(vfu_ctx, VFU_PCI_DEV_BAR0_REGION_IDX, BAR0_SIZE,
-                         &bar0_access, VFU_REGION_FLAG_RW, NULL, 0, -1, 0) < 0) {
-        err(EXIT_FAILURE, "vfu_setup_region failed");
+    /* Dropping the pages is cheaper than clearing them */
+    if (state->mem_fd >= 0) {
+        if (fallocate(state->mem_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      0, state->mem_bar_size) < 0) {
+            memset(state->mem, 0, state->mem_bar_size);
+        }
+#ifdef MADV_POPULATE_WRITE
+        if (state->mem_prefault) {
+            madvise(state->mem, state->mem_bar_size, MADV_POPULATE_WRITE);
+        }
+#endif
     }
 
-    /* Set up device reset callback */
-    if (vfu_setup_device_reset_cb(vfu_ctx, &device_reset) < 0) {
-        err(EXIT_FAILURE, "vfu_setup_device_reset_cb failed");
+    migr_end(state);
+    state->migr.state = VFU_MIGR_STATE_RUNNING;
+
+    state->attached = false;
+    update_poll_fd(epfd, state);
+    printf("%s: Waiting for the next client...\n", state->socket_path);
+}
+
+/*
+ * Handle readiness on a device's poll fd. Returns false once the device's
+ * client has gone away and the device should no longer be polled.
+ */
+static bool handle_device_event(int epfd, struct mock_accel_state *state)
+{
+    if (!state->attached) {
+        if (vfu_attach_ctx(state->vfu_ctx) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return true;
+            }
+            err(EXIT_FAILURE, "vfu_attach_ctx failed for %s", state->socket_path);
+        }
+        state->attached = true;
+        update_poll_fd(epfd, state);
+        printf("%s: QEMU connected, serving device...\n", state->socket_path);
     }
 
-    /* Realize the device */
-    if (vfu_realize_ctx(vfu_ctx) < 0) {
-        err(EXIT_FAILURE, "vfu_realize_ctx failed");
+    /* Process every pending message for this device */
+    int ret = vfu_run_ctx(state->vfu_ctx);
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            dma_resume(state);
+            return true;
+        }
+        if (errno == ENOTCONN || errno == ESHUTDOWN) {
+            printf("%s: Client disconnected\n", state->socket_path);
+            epoll_ctl(epfd, EPOLL_CTL_DEL, state->poll_fd, NULL);
+            state->poll_fd = -1;
+            if (persistent) {
+                device_detached(epfd, state);
+                return true;
+            }
+            return false;
+        }
+        err(EXIT_FAILURE, "vfu_run_ctx failed for %s", state->socket_path);
     }
 
-    printf("Waiting for QEMU to connect...\n");
+    dma_resume(state);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    struct mock_accel_state *devices;
+    struct mock_accel_state legacy;
+    int nr_devices = 0;
+    struct worker *workers = NULL;
+    int nr_workers = -1;  /* -1: derive from --cpus */
+    int cpus[MAX_WORKERS];
+    int nr_cpus = 0;
+    const char *wordlist_path = NULL;
+    const char *stats_path = NULL;
+    struct stats_source *stats_sources = NULL;
+    int node = -1;
+    bool verbose = false;
+    int opt;
+    int option_index = 0;
+
+    static struct option long_options[] = {
+        {"vf",           no_argument,       0, 'V'},
+        {"vf-index",     required_argument, 0, 'I'},
+        {"total-vfs",    required_argument, 0, 'T'},
+        {"device",       required_argument, 0, 'D'},
+        {"config",       required_argument, 0, 'C'},
+        {"workers",      required_argument, 0, 'W'},
+        {"cpus",         required_argument, 0, 'P'},
+        {"wordlist",     required_argument, 0, 'L'},
+        {"numa-node",    required_argument, 0, 'N'},
+        {"stats-socket", required_argument, 0, 'S'},
+        {"memory-bar",   no_argument,       0, 'B'},
+        {"hugepages",    no_argument,       0, 'H'},
+        {"prefault",     no_argument,       0, 'F'},
+        {"persistent",   no_argument,       0, 'R'},
+        {"help",         no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Aligned for the cache-line separated stats in each device */
+    devices = aligned_alloc(64, MAX_DEVICES * sizeof(*devices));
+    if (devices) {
+        memset(devices, 0, MAX_DEVICES * sizeof(*devices));
+    }
+    if (!devices) {
+        err(EXIT_FAILURE, "failed to allocate device table");
+    }
+
+    /*
+     * -u/-m/--vf/--vf-index/--total-vfs and the BAR2 options describe the
+     * positional device
+     */
+    init_device_state(&legacy);
+
+    while ((opt = getopt_long(argc, argv, "vu:m:h", long_options, &option_index)) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = true;
+            break;
+        case 'u':
+            strncpy(legacy.uuid, optarg, sizeof(legacy.uuid) - 1);
+            break;
+        case 'm':
+            legacy.memory_size = parse_size(optarg);
+            legacy.memory_size_set = true;
+            break;
+        case 'V':  /* --vf */
+            legacy.is_vf = true;
+            break;
+        case 'B':  /* --memory-bar */
+            if (legacy.mem_bar == MEM_BAR_NONE) {
+                legacy.mem_bar = MEM_BAR_MEMFD;
+            }
+            break;
+        case 'H':  /* --hugepages */
+            legacy.mem_bar = MEM_BAR_HUGETLB;
+            break;
+        case 'F':  /* --prefault */
+            if (legacy.mem_bar == MEM_BAR_NONE) {
+                legacy.mem_bar = MEM_BAR_MEMFD;
+            }
+            legacy.mem_prefault = true;
+            break;
+        case 'I':  /* --vf-index */
+            legacy.vf_index = (uint16_t)atoi(optarg);
+            break;
+        case 'T':  /* --total-vfs */
+            legacy.total_vfs = (uint16_t)atoi(optarg);
+            if (legacy.total_vfs > MAX_VFS) {
+                fprintf(stderr, "Error: total-vfs cannot exceed %d\n", MAX_VFS);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'D':  /* --device */
+            if (nr_devices >= MAX_DEVICES) {
+                fprintf(stderr, "Error: too many devices (max %d)\n", MAX_DEVICES);
+                exit(EXIT_FAILURE);
+            }
+            if (parse_device_spec(optarg, &devices[nr_devices]) < 0) {
+                exit(EXIT_FAILURE);
+            }
+            nr_devices++;
+            break;
+        case 'C':  /* --config */
+            if (parse_config_file(optarg, devices, &nr_devices) < 0) {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'W':  /* --workers */
+            nr_workers = atoi(optarg);
+            if (nr_workers < 0 || nr_workers > MAX_WORKERS) {
+                fprintf(stderr, "Error: workers must be 0-%d\n", MAX_WORKERS);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'L':  /* --wordlist */
+            wordlist_path = optarg;
+            break;
+        case 'S':  /* --stats-socket */
+            stats_path = optarg;
+            break;
+        case 'R':  /* --persistent */
+            persistent = true;
+            break;
+        case 'N':  /* --numa-node */
+            node = atoi(optarg);
+            if (node < 0 || node >= MAX_NUMA_NODES) {
+                fprintf(stderr, "Error: NUMA node must be 0-%d\n", MAX_NUMA_NODES - 1);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'P':  /* --cpus */
+            nr_cpus = parse_cpu_list(optarg, cpus, MAX_WORKERS);
+            if (nr_cpus <= 0) {
+                fprintf(stderr, "Error: invalid CPU list '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (optind < argc) {
+        if (nr_devices >= MAX_DEVICES) {
+            fprintf(stderr, "Error: too many devices (max %d)\n", MAX_DEVICES);
+            exit(EXIT_FAILURE);
+        }
+        strncpy(legacy.socket_path, argv[optind], sizeof(legacy.socket_path) - 1);
+        devices[nr_devices++] = legacy;
+    }
+
+    if (nr_devices == 0) {
+        fprintf(stderr, "Error: missing socket path\n\n");
+        usage(argv[0]);
+    }
+
+    if (nr_workers < 0) {
+        nr_workers = nr_cpus;
+    }
+
+    /* Before anything big is allocated; the device table already exists */
+    if (node >= 0) {
+        numa_bind(node);
+        numa_bind_range(devices, MAX_DEVICES * sizeof(*devices));
+    }
+
+    compute_init();
+    printf("Compute kernels: crc32c=%s xor=%s\n", compute_crc32c_impl(), compute_xor_impl());
 
-    /* Attach (wait for client) */
-    if (vfu_attach_ctx(vfu_ctx) < 0) {
-        err(EXIT_FAILURE, "vfu_attach_ctx failed");
+    /* Load EFF wordlist for passphrase generation (shared by all devices) */
+    if (load_wordlist(wordlist_path) < 0) {
+        fprintf(stderr, "Warning: Failed to load wordlist, passphrase generation disabled\n");
+    } else {
+        printf("Loaded EFF wordlist (%u words)\n", wordlist.count);
+        if (wordlist.map) {
+            numa_bind_range(wordlist.map, wordlist.map_size);
+        }
+    }
+
+    /* Set up signal handler */
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        err(EXIT_FAILURE, "epoll_create1 failed");
+    }
+
+    if (nr_workers > 0) {
+        workers = calloc(nr_workers, sizeof(*workers));
+        if (!workers) {
+            err(EXIT_FAILURE, "failed to allocate workers");
+        }
+        start_workers(workers, nr_workers, cpus, nr_cpus);
+    }
+
+    for (int i = 0; i < nr_devices; i++) {
+        setup_device(&devices[i], verbose);
+        update_poll_fd(epfd, &devices[i]);
+        if (nr_workers > 0) {
+            devices[i].worker = &workers[i % nr_workers];
+        }
+    }
+
+    if (stats_path) {
+        stats_sources = calloc(nr_devices, sizeof(*stats_sources));
+        if (!stats_sources) {
+            err(EXIT_FAILURE, "failed to allocate stats sources");
+        }
+        for (int i = 0; i < nr_devices; i++) {
+            stats_sources[i].socket = devices[i].socket_path;
+            stats_sources[i].uuid = devices[i].uuid;
+            stats_sources[i].stats = &devices[i].stats;
+        }
+        if (stats_start(stats_path, stats_sources, nr_devices,
+                        stat_reg_names, STAT_NR_REGS) < 0) {
+            err(EXIT_FAILURE, "failed to serve stats on %s", stats_path);
+        }
+        printf("Serving stats on %s\n", stats_path);
     }
 
-    printf("QEMU connected, serving device...\n");
+    if (nr_devices > 1) {
+        printf("Serving %d devices from one process\n", nr_devices);
+    }
+    printf("Waiting for QEMU to connect...\n");
 
     /* Main event loop */
-    while (running) {
-        int ret = vfu_run_ctx(vfu_ctx);
-        if (ret < 0) {
+    struct epoll_event events[64];
+    int nr_active = nr_devices;
+
+    while (running && nr_active > 0) {
+        int n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]), -1);
+        if (n < 0) {
             if (errno == EINTR) {
                 continue;
             }
-            if (errno == ENOTCONN || errno == ESHUTDOWN) {
-                printf("Client disconnected\n");
-                break;
+            err(EXIT_FAILURE, "epoll_wait failed");
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct mock_accel_state *state = events[i].data.ptr;
+
+            if (state->poll_fd < 0) {
+                continue;  /* Already disconnected in this batch */
+            }
+            if (!handle_device_event(epfd, state)) {
+                nr_active--;
             }
-            err(EXIT_FAILURE, "vfu_run_ctx failed");
         }
     }
 
     printf("Shutting down...\n");
-    vfu_destroy_ctx(vfu_ctx);
+    stats_stop();
+    if (nr_workers > 0) {
+        stop_workers(workers, nr_workers);
+        free(workers);
+    }
+    for (int i = 0; i < nr_devices; i++) {
+        vfu_destroy_ctx(devices[i].vfu_ctx);
+        free(devices[i].dma_sg);
+        munmap(devices[i].info_page, MAPPED_SIZE);
+        close(devices[i].info_fd);
+        if (devices[i].mem_fd >= 0) {
+            munmap(devices[i].mem, devices[i].mem_bar_size);
+            close(devices[i].mem_fd);
+        }
+    }
+    close(epfd);
+    free(devices);
+    wordlist_free(&wordlist);
 
     return EXIT_SUCCESS;
 }
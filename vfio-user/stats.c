@@ -0,0 +1,256 @@
+/*
+ * Mock Accelerator statistics
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "stats.h"
+
+static const char *const cmd_names[STATS_NR_CMDS] = {
+    [STATS_CMD_PASSPHRASE] = "passphrase",
+    [STATS_CMD_DESCRIPTOR] = "descriptor",
+};
+
+static struct {
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    int fd;
+    pthread_t thread;
+    const struct stats_source *sources;
+    int nr_sources;
+    const char *const *reg_names;
+    int nr_regs;
+} stats = { .fd = -1 };
+
+void stats_record_latency(struct device_stats *st, enum stats_cmd cmd, uint64_t ns)
+{
+    struct stats_hist *h = &st->cmds[cmd];
+    uint64_t us = (ns + 999) / 1000;
+    unsigned int bucket = 0;
+
+    /* Bucket k holds latencies up to 2^k us */
+    if (us > 1) {
+        bucket = 64 - __builtin_clzll(us - 1);
+    }
+    if (bucket >= STATS_NR_BUCKETS) {
+        bucket = STATS_NR_BUCKETS - 1;
+    }
+
+    stats_inc(&h->buckets[bucket], 1);
+    stats_inc(&h->sum_ns, ns);
+    stats_inc(&h->count, 1);
+}
+
+static uint64_t load(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/* Label values may hold anything a user put in a socket path or UUID */
+static void write_label(FILE *fp, const char *name, const char *value)
+{
+    fprintf(fp, "%s=\"", name);
+    for (; *value; value++) {
+        switch (*value) {
+        case '\\': fputs("\\\\", fp); break;
+        case '"':  fputs("\\\"", fp); break;
+        case '\n': fputs("\\n", fp); break;
+        default:   fputc(*value, fp); break;
+        }
+    }
+    fputc('"', fp);
+}
+
+static void write_device_labels(FILE *fp, const struct stats_source *src)
+{
+    write_label(fp, "socket", src->socket);
+    fputc(',', fp);
+    write_label(fp, "uuid", src->uuid);
+}
+
+static void write_reg_family(FILE *fp, const char *name, const char *help, size_t field)
+{
+    fprintf(fp, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+
+    for (int i = 0; i < stats.nr_sources; i++) {
+        const struct stats_source *src = &stats.sources[i];
+
+        for (int reg = 0; reg < stats.nr_regs; reg++) {
+            const struct stats_reg *r = &src->stats->regs[reg];
+            uint64_t value = load((const uint64_t *)((const char *)r + field));
+
+            /* Most registers are never touched; keep the output short */
+            if (load(&r->reads) == 0 && load(&r->writes) == 0) {
+                continue;
+            }
+            fprintf(fp, "%s{", name);
+            write_device_labels(fp, src);
+            fprintf(fp, ",register=\"%s\"} %lu\n", stats.reg_names[reg], value);
+        }
+    }
+}
+
+static void write_histograms(FILE *fp)
+{
+    static const char name[] = "mock_accel_command_duration_seconds";
+
+    fprintf(fp, "# HELP %s Device command latency\n# TYPE %s histogram\n", name, name);
+
+    for (int i = 0; i < stats.nr_sources; i++) {
+        const struct stats_source *src = &stats.sources[i];
+
+        for (int cmd = 0; cmd < STATS_NR_CMDS; cmd++) {
+            const struct stats_hist *h = &src->stats->cmds[cmd];
+            uint64_t cumulative = 0;
+
+            for (int b = 0; b < STATS_NR_BUCKETS; b++) {
+                cumulative += load(&h->buckets[b]);
+                fprintf(fp, "%s_bucket{", name);
+                write_device_labels(fp, src);
+                if (b == STATS_NR_BUCKETS - 1) {
+                    fprintf(fp, ",command=\"%s\",le=\"+Inf\"} %lu\n", cmd_names[cmd], cumulative);
+                } else {
+                    fprintf(fp, ",command=\"%s\",le=\"%g\"} %lu\n", cmd_names[cmd],
+                            (double)(1ULL << b) / 1e6, cumulative);
+                }
+            }
+
+            fprintf(fp, "%s_sum{", name);
+            write_device_labels(fp, src);
+            fprintf(fp, ",command=\"%s\"} %.9f\n", cmd_names[cmd], load(&h->sum_ns) / 1e9);
+            fprintf(fp, "%s_count{", name);
+            write_device_labels(fp, src);
+            fprintf(fp, ",command=\"%s\"} %lu\n", cmd_names[cmd], load(&h->count));
+        }
+    }
+}
+
+/* Format everything into one buffer so a slow client cannot stall us mid-way */
+static void serve_client(int fd)
+{
+    char *text = NULL;
+    size_t size = 0;
+    FILE *fp = open_memstream(&text, &size);
+
+    if (!fp) {
+        return;
+    }
+
+    write_reg_family(fp, "mock_accel_register_reads_total",
+                     "Trapped register reads", offsetof(struct stats_reg, reads));
+    write_reg_family(fp, "mock_accel_register_writes_total",
+                     "Trapped register writes", offsetof(struct stats_reg, writes));
+    write_reg_family(fp, "mock_accel_register_read_bytes_total",
+                     "Bytes read from trapped registers", offsetof(struct stats_reg, read_bytes));
+    write_reg_family(fp, "mock_accel_register_write_bytes_total",
+                     "Bytes written to trapped registers", offsetof(struct stats_reg, write_bytes));
+    write_histograms(fp);
+
+    if (fclose(fp) != 0) {
+        free(text);
+        return;
+    }
+
+    for (size_t done = 0; done < size;) {
+        ssize_t ret = send(fd, text + done, size - done, MSG_NOSIGNAL);
+
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        done += ret;
+    }
+    free(text);
+}
+
+/* Runs until stats_stop() shuts the listening socket down */
+static void *stats_main(void *arg)
+{
+    /* A client that stops reading cannot hold up stats_stop() for long */
+    static const struct timeval send_timeout = { .tv_sec = 1 };
+
+    (void)arg;
+
+    for (;;) {
+        int fd = accept4(stats.fd, NULL, NULL, SOCK_CLOEXEC);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+        serve_client(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int stats_start(const char *path, const struct stats_source *sources, int nr_sources,
+                const char *const *reg_names, int nr_regs)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int ret;
+
+    if (strlen(path) >= sizeof(addr.sun_path) || nr_regs > STATS_MAX_REGS) {
+        errno = EINVAL;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    stats.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (stats.fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(stats.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(stats.fd, 8) < 0) {
+        close(stats.fd);
+        stats.fd = -1;
+        return -1;
+    }
+    strcpy(stats.path, path);
+
+    stats.sources = sources;
+    stats.nr_sources = nr_sources;
+    stats.reg_names = reg_names;
+    stats.nr_regs = nr_regs;
+
+    ret = pthread_create(&stats.thread, NULL, stats_main, NULL);
+    if (ret != 0) {
+        close(stats.fd);
+        unlink(path);
+        stats.fd = -1;
+        errno = ret;
+        return -1;
+    }
+    pthread_setname_np(stats.thread, "mock-accel-stats");
+    return 0;
+}
+
+void stats_stop(void)
+{
+    if (stats.fd < 0) {
+        return;
+    }
+
+    /* Wakes accept() with EINVAL; the thread finishes the client it is serving */
+    shutdown(stats.fd, SHUT_RDWR);
+    pthread_join(stats.thread, NULL);
+    close(stats.fd);
+    stats.fd = -1;
+    unlink(stats.path);
+}
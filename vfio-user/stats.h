@@ -0,0 +1,106 @@
+/*
+ * Mock Accelerator statistics
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Per-device counters for trapped register accesses and latency
+ * histograms for device commands, served in the Prometheus text format
+ * on a UNIX socket (--stats-socket).
+ *
+ * Every counter has exactly one writer: region accesses are handled on
+ * the event loop thread and commands on the device's worker (or the event
+ * loop without workers). Updates are therefore plain relaxed stores, no
+ * locked instructions, and the two groups live on separate cache lines so
+ * the writers never share one. The stats thread only reads.
+ */
+
+#ifndef MOCK_ACCEL_STATS_H
+#define MOCK_ACCEL_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define STATS_MAX_REGS    32
+#define STATS_NR_BUCKETS  22  /* <= 1us, 2us, ... 2^20us (~1s), +Inf */
+
+/* Commands with a latency histogram */
+enum stats_cmd {
+    STATS_CMD_PASSPHRASE,  /* REG_PASSPHRASE_CMD, submission to completion */
+    STATS_CMD_DESCRIPTOR,  /* One ring descriptor */
+    STATS_NR_CMDS,
+};
+
+struct stats_reg {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+};
+
+struct stats_hist {
+    uint64_t buckets[STATS_NR_BUCKETS];  /* Not cumulative */
+    uint64_t sum_ns;
+    uint64_t count;
+};
+
+struct device_stats {
+    /* Written by the event loop thread */
+    struct stats_reg regs[STATS_MAX_REGS] __attribute__((aligned(64)));
+
+    /* Written by the thread executing the device's commands */
+    struct stats_hist cmds[STATS_NR_CMDS] __attribute__((aligned(64)));
+};
+
+/* A device as shown in the output */
+struct stats_source {
+    const char *socket;
+    const char *uuid;
+    const struct device_stats *stats;
+};
+
+static inline void stats_inc(uint64_t *counter, uint64_t value)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value,
+                     __ATOMIC_RELAXED);
+}
+
+static inline void stats_count_access(struct device_stats *st, unsigned int reg,
+                                      bool is_write, size_t bytes)
+{
+    struct stats_reg *r = &st->regs[reg];
+
+    if (is_write) {
+        stats_inc(&r->writes, 1);
+        stats_inc(&r->write_bytes, bytes);
+    } else {
+        stats_inc(&r->reads, 1);
+        stats_inc(&r->read_bytes, bytes);
+    }
+}
+
+static inline uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void stats_record_latency(struct device_stats *st, enum stats_cmd cmd, uint64_t ns);
+
+/*
+ * Serve stats for devices on a UNIX socket at path from a background
+ * thread. reg_names names the stats_reg slots in use. Returns 0 or -1.
+ */
+int stats_start(const char *path, const struct stats_source *sources, int nr_sources,
+                const char *const *reg_names, int nr_regs);
+
+/*
+ * Stop serving and remove the socket. Returns once the thread has exited,
+ * so the sources can be freed afterwards.
+ */
+void stats_stop(void);
+
+#endif /* MOCK_ACCEL_STATS_H */
@@ -0,0 +1,348 @@
+/*
+ * Mock Accelerator wordlist
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wordlist.h"
+
+static int read_file(const char *path, char **data, size_t *size)
+{
+    struct stat st;
+    char *buf;
+    size_t done = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    buf = malloc(st.st_size + 1);
+    if (!buf) {
+        close(fd);
+        return -1;
+    }
+
+    while (done < (size_t)st.st_size) {
+        ssize_t ret = read(fd, buf + done, st.st_size - done);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            free(buf);
+            close(fd);
+            return -1;
+        }
+        done += ret;
+    }
+    close(fd);
+
+    buf[done] = '\0';
+    *data = buf;
+    *size = done;
+    return 0;
+}
+
+int wordlist_load_text(const char *path, struct wordlist *wl)
+{
+    char *text, *line, *next, *out;
+    size_t size, lines = 0;
+    uint32_t *offsets;
+    uint8_t *lengths;
+    uint32_t count = 0;
+
+    memset(wl, 0, sizeof(*wl));
+
+    if (read_file(path, &text, &size) < 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        if (text[i] == '\n') {
+            lines++;
+        }
+    }
+    lines++;  /* Last line may lack a newline */
+    if (lines > WORDLIST_MAX_WORDS) {
+        lines = WORDLIST_MAX_WORDS;
+    }
+
+    offsets = malloc(lines * (sizeof(*offsets) + sizeof(*lengths)));
+    if (!offsets) {
+        free(text);
+        return -1;
+    }
+    lengths = (uint8_t *)(offsets + lines);
+
+    /* Compact the words in place: the text buffer becomes the blob */
+    out = text;
+    for (line = text; line && *line && count < lines; line = next) {
+        char *word, *end;
+
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+
+        /* Skip dice roll prefix (5 digits + tab) if present */
+        word = strchr(line, '\t');
+        word = word ? word + 1 : line;
+
+        while (*word == ' ' || *word == '\t') {
+            word++;
+        }
+        end = word + strlen(word);
+        while (end > word && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) {
+            end--;
+        }
+        if (end == word) {
+            continue;
+        }
+        if (end - word > WORDLIST_MAX_WORD_LEN) {
+            fprintf(stderr, "Error: word too long in %s\n", path);
+            free(offsets);
+            free(text);
+            errno = EINVAL;
+            return -1;
+        }
+
+        size_t len = end - word;
+        memmove(out, word, len);
+        offsets[count] = out - text;
+        lengths[count] = (uint8_t)len;
+        out[len] = '\0';
+        out += len + 1;
+        count++;
+    }
+
+    if (count == 0) {
+        free(offsets);
+        free(text);
+        errno = ENODATA;
+        return -1;
+    }
+
+    wl->count = count;
+    wl->offsets = offsets;
+    wl->lengths = lengths;
+    wl->blob = text;
+    wl->index = offsets;
+    wl->text = text;
+    return 0;
+}
+
+int wordlist_load_image(const char *path, struct wordlist *wl)
+{
+    const struct wordlist_image_header *hdr;
+    struct stat st;
+    size_t index_size;
+    void *map;
+    int fd;
+
+    memset(wl, 0, sizeof(*wl));
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(*hdr)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    hdr = map;
+    index_size = wordlist_image_index_size(hdr->count);
+    if (memcmp(hdr->magic, WORDLIST_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != WORDLIST_VERSION ||
+        hdr->count == 0 || hdr->count > WORDLIST_MAX_WORDS ||
+        sizeof(*hdr) + index_size + hdr->blob_size != (size_t)st.st_size) {
+        fprintf(stderr, "Error: %s is not a valid wordlist image\n", path);
+        munmap(map, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    wl->count = hdr->count;
+    wl->offsets = (const uint32_t *)(hdr + 1);
+    wl->lengths = (const uint8_t *)(wl->offsets + hdr->count);
+    wl->blob = (const char *)(hdr + 1) + index_size;
+    wl->map = map;
+    wl->map_size = st.st_size;
+
+    /* Every word must lie inside the blob and be NUL-terminated */
+    for (uint32_t i = 0; i < wl->count; i++) {
+        if ((uint64_t)wl->offsets[i] + wl->lengths[i] >= hdr->blob_size ||
+            wl->blob[wl->offsets[i] + wl->lengths[i]] != '\0') {
+            fprintf(stderr, "Error: %s: word %u out of bounds\n", path, i);
+            wordlist_free(wl);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int wordlist_load(const char *path, struct wordlist *wl)
+{
+    char magic[sizeof(((struct wordlist_image_header *)0)->magic)];
+    ssize_t ret;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ret = read(fd, magic, sizeof(magic));
+    close(fd);
+
+    if (ret == (ssize_t)sizeof(magic) && memcmp(magic, WORDLIST_MAGIC, sizeof(magic)) == 0) {
+        return wordlist_load_image(path, wl);
+    }
+    return wordlist_load_text(path, wl);
+}
+
+int wordlist_write_image(const struct wordlist *wl, const char *path)
+{
+    struct wordlist_image_header hdr = {
+        .magic = WORDLIST_MAGIC,
+        .version = WORDLIST_VERSION,
+        .count = wl->count,
+    };
+    static const char pad[4];
+    size_t index_bytes = (size_t)wl->count * (sizeof(uint32_t) + sizeof(uint8_t));
+    uint32_t *offsets;
+    FILE *fp;
+    int ret = 0;
+
+    /* Re-pack the blob so the image holds exactly the indexed words */
+    offsets = malloc(wl->count * sizeof(*offsets));
+    if (!offsets) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < wl->count; i++) {
+        offsets[i] = hdr.blob_size;
+        hdr.blob_size += wl->lengths[i] + 1;
+    }
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        free(offsets);
+        return -1;
+    }
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        fwrite(offsets, sizeof(*offsets), wl->count, fp) != wl->count ||
+        fwrite(wl->lengths, sizeof(*wl->lengths), wl->count, fp) != wl->count ||
+        fwrite(pad, 1, wordlist_image_index_size(wl->count) - index_bytes, fp) !=
+            wordlist_image_index_size(wl->count) - index_bytes) {
+        ret = -1;
+    }
+    for (uint32_t i = 0; ret == 0 && i < wl->count; i++) {
+        if (fwrite(wl->blob + wl->offsets[i], 1, wl->lengths[i] + 1, fp) !=
+            (size_t)wl->lengths[i] + 1) {
+            ret = -1;
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        ret = -1;
+    }
+    free(offsets);
+    return ret;
+}
+
+int wordlist_write_source(const struct wordlist *wl, const char *path)
+{
+    uint32_t offset = 0;
+    FILE *fp;
+    int ret = 0;
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+
+    fprintf(fp, "/* Generated by mkwordlist -c; do not edit */\n\n");
+    fprintf(fp, "#include \"wordlist.h\"\n\n");
+
+    fprintf(fp, "static const uint32_t offsets[%u] = {\n", wl->count);
+    for (uint32_t i = 0; i < wl->count; i++) {
+        fprintf(fp, "%s%u,%s", i % 8 ? " " : "    ", offset, i % 8 == 7 ? "\n" : "");
+        offset += wl->lengths[i] + 1;
+    }
+    fprintf(fp, "%s};\n\n", wl->count % 8 ? "\n" : "");
+
+    fprintf(fp, "static const uint8_t lengths[%u] = {\n", wl->count);
+    for (uint32_t i = 0; i < wl->count; i++) {
+        fprintf(fp, "%s%u,%s", i % 16 ? " " : "    ", wl->lengths[i], i % 16 == 15 ? "\n" : "");
+    }
+    fprintf(fp, "%s};\n\n", wl->count % 16 ? "\n" : "");
+
+    /* One literal per word; octal escapes keep any byte value safe */
+    fprintf(fp, "static const char blob[%u] =\n", offset);
+    for (uint32_t i = 0; i < wl->count; i++) {
+        const unsigned char *word = (const unsigned char *)wl->blob + wl->offsets[i];
+
+        fputs("    \"", fp);
+        for (uint8_t j = 0; j < wl->lengths[i]; j++) {
+            if (word[j] < 0x20 || word[j] >= 0x7f || word[j] == '"' || word[j] == '\\' ||
+                word[j] == '?') {
+                fprintf(fp, "\\%03o", word[j]);
+            } else {
+                fputc(word[j], fp);
+            }
+        }
+        fprintf(fp, "\\0\"%s\n", i + 1 == wl->count ? ";" : "");
+    }
+
+    fprintf(fp, "\nconst struct wordlist wordlist_embedded = {\n");
+    fprintf(fp, "    .count = %u,\n", wl->count);
+    fprintf(fp, "    .offsets = offsets,\n");
+    fprintf(fp, "    .lengths = lengths,\n");
+    fprintf(fp, "    .blob = blob,\n");
+    fprintf(fp, "};\n");
+
+    if (ferror(fp)) {
+        ret = -1;
+    }
+    if (fclose(fp) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+void wordlist_free(struct wordlist *wl)
+{
+    if (wl->map) {
+        munmap(wl->map, wl->map_size);
+    }
+    free(wl->index);
+    free(wl->text);
+    memset(wl, 0, sizeof(*wl));
+}
@@ -0,0 +1,79 @@
+/*
+ * Mock Accelerator wordlist
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * A wordlist is held as a packed index (offset + length per word) over a
+ * single blob of NUL-terminated strings. It can be parsed from the EFF text
+ * file or mapped read-only from a precompiled image, so every server
+ * process on a node shares one page-cache copy.
+ *
+ * Image layout (little-endian):
+ *
+ *   struct wordlist_image_header  header
+ *   uint32_t                      offsets[count]   blob offset of each word
+ *   uint8_t                       lengths[count]   strlen() of each word
+ *   (padding to 4 bytes)
+ *   char                          blob[blob_size]  NUL-terminated words
+ */
+
+#ifndef MOCK_ACCEL_WORDLIST_H
+#define MOCK_ACCEL_WORDLIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WORDLIST_MAGIC         "MAWL"
+#define WORDLIST_VERSION       1
+#define WORDLIST_MAX_WORDS     65536
+#define WORDLIST_MAX_WORD_LEN  255
+
+struct wordlist_image_header {
+    char magic[4];        /* WORDLIST_MAGIC */
+    uint32_t version;     /* WORDLIST_VERSION */
+    uint32_t count;       /* Number of words */
+    uint32_t blob_size;   /* Bytes in the string blob */
+};
+
+struct wordlist {
+    uint32_t count;
+    const uint32_t *offsets;
+    const uint8_t *lengths;
+    const char *blob;
+
+    /* Backing storage, released by wordlist_free() */
+    void *map;            /* mmap()ed image */
+    size_t map_size;
+    void *index;          /* Heap index and blob for parsed text */
+    void *text;
+};
+
+/* Load a text or image wordlist, detected by magic. Returns 0 or -1. */
+int wordlist_load(const char *path, struct wordlist *wl);
+
+/* Parse a text wordlist: "word" or "<dice>\tword" per line */
+int wordlist_load_text(const char *path, struct wordlist *wl);
+
+/* Map a precompiled image read-only */
+int wordlist_load_image(const char *path, struct wordlist *wl);
+
+/* Write wl as an image to path */
+int wordlist_write_image(const struct wordlist *wl, const char *path);
+
+/* Write wl as C source defining wordlist_embedded */
+int wordlist_write_source(const struct wordlist *wl, const char *path);
+
+void wordlist_free(struct wordlist *wl);
+
+#ifdef WORDLIST_EMBEDDED
+/* Table generated by "mkwordlist -c" and linked into the binary */
+extern const struct wordlist wordlist_embedded;
+#endif
+
+static inline size_t wordlist_image_index_size(uint32_t count)
+{
+    /* offsets + lengths, padded so the blob starts 4-byte aligned */
+    return ((size_t)count * (sizeof(uint32_t) + sizeof(uint8_t)) + 3) & ~(size_t)3;
+}
+
+#endif /* MOCK_ACCEL_WORDLIST_H */